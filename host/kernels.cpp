@@ -0,0 +1,50 @@
+/**
+ * Kernels
+ * Runs the firmware's kernel benchmarks (see bench.h) on the host, on the
+ * real clock, and reports the time per byte and per pixel of each kernel at
+ * each payload size.
+ */
+
+#include <Arduino.h>
+
+#include "bench.h"
+#include "serial.h"
+
+void setup();
+
+void report(const char *kernel, int bytes, int pixels, long iterations, unsigned long elapsed) {
+    double ns = elapsed * 1000.0 / iterations;
+    printf("%-10s %8d %8d %10ld %12.1f %10.3f %10.2f\n",
+        kernel, bytes, pixels, iterations, ns, bytes ? ns / bytes : 0.0, pixels ? ns / pixels : 0.0);
+}
+
+void usage() {
+    fprintf(stderr,
+        "usage: kernels [--budget N]\n"
+        "  --budget  payload bytes each kernel is run over at each size (default 16777216)\n"
+    );
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    long budget = 16777216;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--budget") && i + 1 < argc) {
+            budget = atol(argv[++i]);
+        } else {
+            usage();
+        }
+    }
+
+    host_serial_out = fopen("/dev/null", "w");
+    setup();
+    host_realtime = true;
+
+    printf("%-10s %8s %8s %10s %12s %10s %10s\n", "kernel", "bytes", "pixels", "iterations", "ns/iter", "ns/byte", "ns/pixel");
+    int error_code = bench_kernels(report, budget);
+    if (error_code) {
+        fprintf(stderr, "E%03d %s\n", error_code, msg_buffer);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""
+Capture generator.
+
+Writes a GCode stream of full frames to stdout, for the replay driver: each
+frame sets every panel with numbered, checksummed M2600 lines and shows it
+with M2610. With --ber, bits are flipped as if the stream had been captured
+from a noisy link, so the firmware asks for resends that never come.
+
+Example:
+
+    host/make_capture.py --frames 200 --panels 316,260,260,260 > frames.gcode
+"""
+
+import argparse
+import base64
+import colorsys
+import random
+import sys
+
+# Longest payload sent in a single M2600, in pixels
+PIXELS_PER_LINE = 300
+
+
+def checksum(line):
+    value = 0
+    for char in line:
+        value ^= ord(char)
+    return '%02X' % value
+
+
+def numbered(linenum, command):
+    line = 'N%d %s' % (linenum, command)
+    return '%s*%s\n' % (line, checksum(line))
+
+
+def frame_commands(frame, panels):
+    for panel, length in enumerate(panels):
+        pixels = bytearray()
+        for pixel in range(length):
+            hue = ((pixel / float(length)) + frame / 100.0) % 1.0
+            pixels.extend(int(c * 255) for c in colorsys.hsv_to_rgb(hue, 1, 1))
+        for offset in range(0, length, PIXELS_PER_LINE):
+            chunk = pixels[offset * 3:(offset + PIXELS_PER_LINE) * 3]
+            yield 'M2600 Q%d S%d V%s' % (panel, offset, base64.b64encode(bytes(chunk)).decode('ascii'))
+    yield 'M2610'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--frames', type=int, default=100)
+    parser.add_argument('--panels', default='316,260,260,260', help='comma separated panel lengths')
+    parser.add_argument('--ber', type=float, default=0, help='bit error rate')
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+
+    panels = [int(length) for length in args.panels.split(',')]
+    rng = random.Random(args.seed)
+    out = bytearray(numbered(0, 'M110 N0').encode('ascii'))
+    linenum = 1
+    for frame in range(args.frames):
+        for command in frame_commands(frame, panels):
+            line = bytearray(numbered(linenum, command).encode('ascii'))
+            if args.ber:
+                for bit in range(len(line) * 8):
+                    if rng.random() < args.ber:
+                        line[bit // 8] ^= 1 << (bit % 8)
+            out.extend(line)
+            linenum += 1
+    sys.stdout.buffer.write(out)
+
+
+if __name__ == '__main__':
+    main()
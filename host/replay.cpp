@@ -0,0 +1,222 @@
+/**
+ * Replay
+ * Runs the firmware on the host, feeding it a captured GCode stream, and
+ * reports how fast it got through it.
+ *
+ * The stream arrives at the baud rate on the virtual clock, loop() costs a
+ * fixed time per call, and the LEDs take as long as they would to clock out,
+ * so the same stream and options always give the same report.
+ *
+ * With --pty, the firmware serves a pty on the real clock instead, for the
+ * host tools to talk to.
+ */
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "queue.h"
+#include "panel.h"
+#include "jitter.h"
+
+void setup();
+void loop();
+
+// Lines that show a frame, by the time their line end arrives
+std::deque<uint64_t> show_arrivals;
+std::vector<uint64_t> latencies;
+long frames_shown = 0;
+long resends = 0;
+long errors = 0;
+
+void on_show() {
+    frames_shown++;
+    // Frames shown before the first command are the boot rainbows
+    if (!commands_processed || show_arrivals.empty() || show_arrivals.front() > host_clock_us) {
+        return;
+    }
+    latencies.push_back(host_clock_us - show_arrivals.front());
+    show_arrivals.pop_front();
+}
+
+void on_line(const char *line) {
+    const char *status = strstr(line, ": ");
+    status = status ? status + 2 : line;
+    if (!strncmp(status, "RS ", 3) || !strncmp(status, "RL ", 3)) {
+        resends++;
+    } else if (line[0] == 'E' || (line[0] == 'N' && strstr(line, " E0"))) {
+        errors++;
+    }
+}
+
+/**
+ * Whether a line shows a frame, i.e. is an M2610, M2611 or M2613
+ */
+bool is_show_line(const char *line, const char *end) {
+    while (line < end && (*line == ' ' || *line == '\t')) {
+        line++;
+    }
+    if (line < end && *line == 'N') {
+        while (line < end && *line != ' ') {
+            line++;
+        }
+        while (line < end && *line == ' ') {
+            line++;
+        }
+    }
+    return (end - line >= 5) && (
+        !strncmp(line, "M2610", 5) || !strncmp(line, "M2611", 5) || !strncmp(line, "M2613", 5)
+    );
+}
+
+std::vector<char> read_file(const char *path) {
+    std::vector<char> data;
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    char buffer[4096];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + len);
+    }
+    fclose(file);
+    return data;
+}
+
+/**
+ * Queue the capture to arrive at baud from the current time, noting when each show line ends
+ */
+void feed_capture(const std::vector<char> &capture, long baud) {
+    uint64_t started = host_clock_us;
+    size_t line_start = 0;
+    for (size_t i = 0; i < capture.size(); i++) {
+        uint64_t arrival = started + (baud ? (uint64_t)i * 10000000 / baud : 0);
+        host_serial_feed(&capture[i], 1, arrival);
+        if (capture[i] == '\n') {
+            if (is_show_line(&capture[line_start], &capture[i])) {
+                show_arrivals.push_back(arrival);
+            }
+            line_start = i + 1;
+        }
+    }
+}
+
+int serve_pty() {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) {
+        perror("pty");
+        return 1;
+    }
+    // Without raw mode the pty echoes the firmware's output back to it as commands
+    struct termios raw;
+    tcgetattr(master, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(master, TCSANOW, &raw);
+    fprintf(stderr, "serving on %s\n", ptsname(master));
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    host_realtime = true;
+    host_serial_fd = master;
+    host_serial_out = fdopen(dup(master), "w");
+    setup();
+    while (true) {
+        loop();
+        host_advance(100);
+    }
+}
+
+double percentile(std::vector<uint64_t> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))] / 1000.0;
+}
+
+void usage() {
+    fprintf(stderr,
+        "usage: replay CAPTURE [--baud N] [--loop-us N] [--out FILE]\n"
+        "       replay --pty\n"
+        "  --baud     rate the capture arrives at, 0 for all at once (default SERIAL_BAUD)\n"
+        "  --loop-us  virtual time each loop() takes (default 20)\n"
+        "  --out      file for the firmware's serial output (default none)\n"
+        "  --pty      serve the firmware on a pty on the real clock\n"
+    );
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *capture_path = NULL;
+    const char *out_path = "/dev/null";
+    long baud = SERIAL_BAUD;
+    long loop_us = 20;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--pty")) {
+            return serve_pty();
+        } else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+            baud = atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--loop-us") && i + 1 < argc) {
+            loop_us = atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (argv[i][0] != '-' && !capture_path) {
+            capture_path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (!capture_path) {
+        usage();
+    }
+
+    host_serial_out = fopen(out_path, "w");
+    if (!host_serial_out) {
+        perror(out_path);
+        return 1;
+    }
+    host_serial_line_hook = on_line;
+    host_show_hook = on_show;
+
+    std::vector<char> capture = read_file(capture_path);
+    clock_t cpu_started = clock();
+
+    setup();
+    uint64_t started = host_clock_us;
+    feed_capture(capture, baud);
+    long long commands_at_start = commands_processed;
+    int pixels_at_start = pixels_set;
+    uint64_t finished = started;
+    // Run until everything has been received, processed and shown, then a little longer for stragglers
+    while (host_clock_us - finished < 100000) {
+        loop();
+        host_advance(loop_us);
+        if (host_serial_pending() || queue_length() || panels_outputting || jitter_pending()) {
+            finished = host_clock_us;
+        }
+    }
+    double cpu_seconds = (double)(clock() - cpu_started) / CLOCKS_PER_SEC;
+    fclose(host_serial_out);
+
+    double seconds = (finished - started) / 1000000.0;
+    long long commands = commands_processed - commands_at_start;
+    long pixels = pixels_set - pixels_at_start;
+    printf("capture:      %zu bytes at %ld baud, %.3f s virtual\n", capture.size(), baud, seconds);
+    printf("commands:     %lld, %.0f cmd/s\n", commands, commands / seconds);
+    printf("pixels:       %ld, %.0f px/s\n", pixels, pixels / seconds);
+    printf("frames:       %ld shown, %.1f fps\n", frames_shown, frames_shown / seconds);
+    printf("latency ms:   p50 %.3f, p99 %.3f, max %.3f over %zu frames\n",
+        percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 1.0), latencies.size());
+    printf("resends:      %ld\n", resends);
+    printf("errors:       %ld\n", errors);
+    // Not deterministic, unlike the rest of the report
+    printf("host cpu:     %.3f s, %.0f ns/cmd\n", cpu_seconds, commands ? cpu_seconds * 1e9 / commands : 0.0);
+    return 0;
+}
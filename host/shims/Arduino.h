@@ -0,0 +1,107 @@
+/**
+ * Host Arduino
+ * Just enough of the Arduino core to build the firmware on Linux, see "Host Build" in README.md.
+ *
+ * The clock is virtual: it only moves when the replay driver advances it, or
+ * when the firmware calls delay() or clocks out LEDs, so runs are repeatable.
+ * Serial reads from bytes the driver queues with an arrival time on that
+ * clock, and writes to a file.
+ */
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+#define INPUT 0
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define strncpy_P strncpy
+#define strncmp_P strncmp
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+template <typename T, typename U> inline T min(T a, U b) { return (b < a) ? b : a; }
+template <typename T, typename U> inline T max(T a, U b) { return (b > a) ? b : a; }
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef uint8_t byte;
+
+/**
+ * Virtual Clock
+ */
+extern uint64_t host_clock_us;
+
+// Run on the real clock instead, e.g. when serving a pty
+extern bool host_realtime;
+
+void host_advance(uint64_t us);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+inline void yield() {}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+
+/**
+ * SRAM left, modelled as HOST_SRAM_SIZE less what has been malloced since start up
+ */
+int host_free_sram();
+
+/**
+ * Serial
+ */
+class HostSerial
+{
+  public:
+    void begin(unsigned long baud) {}
+    operator bool() { return true; }
+
+    int available();
+    int peek();
+    int read();
+    size_t readBytes(char *buffer, size_t len);
+
+    size_t print(const char *str);
+    size_t print(char c);
+    size_t print(int value);
+    size_t println(const char *str);
+    size_t println(int value);
+    size_t println();
+    void flush();
+    void send_now() {}
+};
+
+extern HostSerial Serial;
+
+/**
+ * Queue bytes for Serial to read once the clock reaches arrival_us
+ */
+void host_serial_feed(const char *data, size_t len, uint64_t arrival_us);
+
+// Bytes queued that Serial has not read yet
+size_t host_serial_pending();
+
+// Where Serial writes to, stdout by default
+extern FILE *host_serial_out;
+// File descriptor Serial reads from instead of the fed bytes, e.g. a pty, -1 for none
+extern int host_serial_fd;
+
+/**
+ * Called with each line Serial writes, without the line end
+ */
+typedef void (*host_line_fn)(const char *line);
+extern host_line_fn host_serial_line_hook;
+
+#endif /* __HOST_ARDUINO_H__ */
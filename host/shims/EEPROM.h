@@ -0,0 +1,34 @@
+/**
+ * Host EEPROM
+ * HOST_EEPROM_SIZE bytes in RAM, erased (0xff) at start up.
+ */
+
+#ifndef __HOST_EEPROM_H__
+#define __HOST_EEPROM_H__
+
+#include <Arduino.h>
+
+#define HOST_EEPROM_SIZE 2048
+
+extern uint8_t host_eeprom[HOST_EEPROM_SIZE];
+
+class HostEEPROM
+{
+  public:
+    uint8_t read(int address) { return host_eeprom[address]; }
+    void write(int address, uint8_t value) { host_eeprom[address] = value; }
+    void update(int address, uint8_t value) { host_eeprom[address] = value; }
+    uint16_t length() { return HOST_EEPROM_SIZE; }
+};
+
+extern HostEEPROM EEPROM;
+
+// avr-libc style access, addresses are offsets cast to pointers
+inline uint8_t eeprom_read_byte(const uint8_t *address) {
+    return host_eeprom[(uintptr_t)address];
+}
+inline void eeprom_write_byte(uint8_t *address, uint8_t value) {
+    host_eeprom[(uintptr_t)address] = value;
+}
+
+#endif /* __HOST_EEPROM_H__ */
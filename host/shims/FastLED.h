@@ -0,0 +1,116 @@
+/**
+ * Host FastLED
+ * Pixels, and controllers that take as long as the LEDs they model would to
+ * clock out on the virtual clock, without any hardware.
+ */
+
+#ifndef __HOST_FASTLED_H__
+#define __HOST_FASTLED_H__
+
+#include <Arduino.h>
+
+#define DATA_RATE_MHZ(X) ((X) * 1000000UL)
+
+enum ESPIChipsets { APA102, SK9822, LPD8806, WS2801 };
+enum EOrder { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 };
+
+template <uint8_t DATA_PIN> class NEOPIXEL {};
+
+struct CRGB {
+    union {
+        struct {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+        };
+        uint8_t raw[3];
+    };
+
+    CRGB() {}
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+
+    CRGB &setRGB(uint8_t nr, uint8_t ng, uint8_t nb) {
+        r = nr;
+        g = ng;
+        b = nb;
+        return *this;
+    }
+
+    // A plain spectrum conversion, which is close enough to FastLED's rainbow for replays
+    CRGB &setHSV(uint8_t hue, uint8_t sat, uint8_t val);
+
+    uint8_t &operator[](uint8_t x) { return raw[x]; }
+    const uint8_t &operator[](uint8_t x) const { return raw[x]; }
+};
+
+inline bool operator==(const CRGB &lhs, const CRGB &rhs) {
+    return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b;
+}
+inline bool operator!=(const CRGB &lhs, const CRGB &rhs) {
+    return !(lhs == rhs);
+}
+
+void fill_solid(CRGB *leds, int count, const CRGB &color);
+
+class CLEDController
+{
+  public:
+    CRGB *leds;
+    int count;
+    unsigned long bits_per_led;
+    unsigned long overhead_bits;
+    unsigned long data_rate;        // bits per second
+    unsigned long latch_us;
+
+    // Advances the clock by the time the LEDs take to clock out
+    void showLeds(uint8_t brightness);
+};
+
+#define HOST_MAX_CONTROLLERS 8
+
+class CFastLED
+{
+  public:
+    template <ESPIChipsets CHIPSET, uint8_t DATA_PIN, uint8_t CLOCK_PIN, EOrder RGB_ORDER, unsigned long SPI_DATA_RATE>
+    CLEDController &addLeds(CRGB *data, int count) {
+        // APA102 style: 32 bit start frame, 32 bits per LED, half a bit per LED of end frame
+        return add(data, count, 32, 32 + count / 2, SPI_DATA_RATE, 0);
+    }
+
+    template <template <uint8_t DATA_PIN> class CHIPSET, uint8_t DATA_PIN>
+    CLEDController &addLeds(CRGB *data, int count) {
+        // WS2812 style: 24 bits per LED at 800 kHz then a 50 us latch
+        return add(data, count, 24, 0, 800000UL, 50);
+    }
+
+    void setBrightness(uint8_t scale) { brightness = scale; }
+    uint8_t getBrightness() { return brightness; }
+
+    void show();
+    void countFPS(int frames = 25);
+    uint16_t getFPS() { return fps; }
+
+    int size() { return controller_count; }
+    CLEDController &operator[](int x) { return controllers[x]; }
+
+  private:
+    CLEDController &add(CRGB *data, int count, unsigned long bits_per_led, unsigned long overhead_bits,
+                        unsigned long data_rate, unsigned long latch_us);
+
+    CLEDController controllers[HOST_MAX_CONTROLLERS];
+    int controller_count = 0;
+    uint8_t brightness = 255;
+    uint16_t fps = 0;
+    int fps_frames = 0;
+    unsigned long fps_started = 0;
+};
+
+extern CFastLED FastLED;
+
+/**
+ * Called each time a whole frame has been shown, i.e. on countFPS()
+ */
+typedef void (*host_show_fn)();
+extern host_show_fn host_show_hook;
+
+#endif /* __HOST_FASTLED_H__ */
@@ -0,0 +1,6 @@
+#ifndef __HOST_TIMELIB_H__
+#define __HOST_TIMELIB_H__
+
+#include <time.h>
+
+#endif /* __HOST_TIMELIB_H__ */
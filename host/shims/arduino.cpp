@@ -0,0 +1,188 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#include <malloc.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+
+uint64_t host_clock_us = 0;
+bool host_realtime = false;
+
+HostSerial Serial;
+FILE *host_serial_out = stdout;
+int host_serial_fd = -1;
+host_line_fn host_serial_line_hook = NULL;
+
+uint8_t host_eeprom[HOST_EEPROM_SIZE];
+HostEEPROM EEPROM;
+
+#define HOST_SERIAL_BUFFER 512
+
+struct FedByte {
+    uint64_t arrival_us;
+    char value;
+};
+
+std::deque<FedByte> serial_in;
+
+// The line Serial is writing, for host_serial_line_hook
+char serial_line[512];
+size_t serial_line_len = 0;
+
+uint64_t realtime_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void host_advance(uint64_t us) {
+    if (host_realtime) {
+        usleep(us);
+        return;
+    }
+    host_clock_us += us;
+}
+
+unsigned long micros() {
+    if (host_realtime) {
+        static uint64_t started = realtime_us();
+        return realtime_us() - started;
+    }
+    return host_clock_us;
+}
+
+unsigned long millis() {
+    return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+    host_advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    host_advance(us);
+}
+
+#ifndef HOST_SRAM_SIZE
+#define HOST_SRAM_SIZE 49152
+#endif
+
+int host_free_sram() {
+    static size_t allocated_at_start = mallinfo2().uordblks;
+    return HOST_SRAM_SIZE - (int)(mallinfo2().uordblks - allocated_at_start);
+}
+
+void host_serial_feed(const char *data, size_t len, uint64_t arrival_us) {
+    for (size_t i = 0; i < len; i++) {
+        serial_in.push_back(FedByte{arrival_us, data[i]});
+    }
+}
+
+size_t host_serial_pending() {
+    return serial_in.size();
+}
+
+/**
+ * Move bytes that have arrived on host_serial_fd into serial_in
+ */
+void poll_serial_fd() {
+    if (host_serial_fd < 0) {
+        return;
+    }
+    char buffer[256];
+    ssize_t len = ::read(host_serial_fd, buffer, sizeof(buffer));
+    if (len > 0) {
+        host_serial_feed(buffer, len, 0);
+    }
+}
+
+int HostSerial::available() {
+    poll_serial_fd();
+    int count = 0;
+    uint64_t now = micros();
+    // Counting stops at a USB packet's worth, like the board's receive buffer
+    for (std::deque<FedByte>::iterator it = serial_in.begin(); it != serial_in.end() && it->arrival_us <= now; ++it) {
+        if (++count == HOST_SERIAL_BUFFER) {
+            break;
+        }
+    }
+    return count;
+}
+
+int HostSerial::peek() {
+    if (!available()) {
+        return -1;
+    }
+    return (uint8_t)serial_in.front().value;
+}
+
+int HostSerial::read() {
+    if (!available()) {
+        return -1;
+    }
+    char value = serial_in.front().value;
+    serial_in.pop_front();
+    return (uint8_t)value;
+}
+
+size_t HostSerial::readBytes(char *buffer, size_t len) {
+    size_t count = 0;
+    uint64_t now = micros();
+    while (count < len && !serial_in.empty() && serial_in.front().arrival_us <= now) {
+        buffer[count++] = serial_in.front().value;
+        serial_in.pop_front();
+    }
+    return count;
+}
+
+size_t HostSerial::print(const char *str) {
+    size_t len = strlen(str);
+    fwrite(str, 1, len, host_serial_out);
+    for (size_t i = 0; i < len; i++) {
+        if (serial_line_len < sizeof(serial_line) - 1) {
+            serial_line[serial_line_len++] = str[i];
+        }
+    }
+    return len;
+}
+
+size_t HostSerial::print(char c) {
+    char str[2] = {c, '\0'};
+    return print(str);
+}
+
+size_t HostSerial::print(int value) {
+    char str[16];
+    snprintf(str, sizeof(str), "%d", value);
+    return print(str);
+}
+
+size_t HostSerial::println() {
+    fputs("\r\n", host_serial_out);
+    serial_line[serial_line_len] = '\0';
+    serial_line_len = 0;
+    if (host_serial_line_hook) {
+        host_serial_line_hook(serial_line);
+    }
+    return 2;
+}
+
+size_t HostSerial::println(const char *str) {
+    return print(str) + println();
+}
+
+size_t HostSerial::println(int value) {
+    return print(value) + println();
+}
+
+void HostSerial::flush() {
+    fflush(host_serial_out);
+}
+
+/**
+ * Erase the EEPROM before anything reads it
+ */
+struct EraseEEPROM {
+    EraseEEPROM() { memset(host_eeprom, 0xff, sizeof(host_eeprom)); }
+} erase_eeprom;
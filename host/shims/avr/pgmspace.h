@@ -0,0 +1,7 @@
+#ifndef __HOST_PGMSPACE_H__
+#define __HOST_PGMSPACE_H__
+
+// Program memory is ordinary memory on the host, see Arduino.h
+#include <Arduino.h>
+
+#endif /* __HOST_PGMSPACE_H__ */
@@ -0,0 +1,66 @@
+#include <FastLED.h>
+
+CFastLED FastLED;
+host_show_fn host_show_hook = NULL;
+
+CRGB &CRGB::setHSV(uint8_t hue, uint8_t sat, uint8_t val) {
+    // Six sections of 256 / 6 hues each, blended linearly
+    uint8_t section = hue / 43;
+    uint8_t ramp = (hue - section * 43) * 6;
+    uint8_t floor = (uint16_t)val * (255 - sat) / 255;
+    uint8_t rise = floor + (uint16_t)(val - floor) * ramp / 255;
+    uint8_t fall = val - (uint16_t)(val - floor) * ramp / 255;
+    switch (section) {
+    case 0: return setRGB(val, rise, floor);
+    case 1: return setRGB(fall, val, floor);
+    case 2: return setRGB(floor, val, rise);
+    case 3: return setRGB(floor, fall, val);
+    case 4: return setRGB(rise, floor, val);
+    default: return setRGB(val, floor, fall);
+    }
+}
+
+void fill_solid(CRGB *leds, int count, const CRGB &color) {
+    for (int i = 0; i < count; i++) {
+        leds[i] = color;
+    }
+}
+
+void CLEDController::showLeds(uint8_t brightness) {
+    uint64_t bits = (uint64_t)bits_per_led * count + overhead_bits;
+    host_advance(bits * 1000000 / data_rate + latch_us);
+}
+
+CLEDController &CFastLED::add(CRGB *data, int count, unsigned long bits_per_led, unsigned long overhead_bits,
+                              unsigned long data_rate, unsigned long latch_us) {
+    CLEDController &controller = controllers[controller_count++];
+    controller.leds = data;
+    controller.count = count;
+    controller.bits_per_led = bits_per_led;
+    controller.overhead_bits = overhead_bits;
+    controller.data_rate = data_rate;
+    controller.latch_us = latch_us;
+    return controller;
+}
+
+void CFastLED::show() {
+    for (int i = 0; i < controller_count; i++) {
+        controllers[i].showLeds(brightness);
+    }
+    countFPS();
+}
+
+void CFastLED::countFPS(int frames) {
+    if (host_show_hook) {
+        host_show_hook();
+    }
+    if (++fps_frames < frames) {
+        return;
+    }
+    unsigned long now = millis();
+    if (now > fps_started) {
+        fps = (uint32_t)fps_frames * 1000 / (now - fps_started);
+    }
+    fps_started = now;
+    fps_frames = 0;
+}
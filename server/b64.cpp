@@ -6,10 +6,30 @@ const char PROGMEM b64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                                     "abcdefghijklmnopqrstuvwxyz"
                                     "0123456789+/";
 
+// Value of each base64 digit, BAD for characters that aren't base64 digits
+#define BAD 0xFF
+const uint8_t PROGMEM b64_values[256] = {
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,  62, BAD, BAD, BAD,  63,
+     52,  53,  54,  55,  56,  57,  58,  59,  60,  61, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, BAD, BAD, BAD, BAD, BAD,
+    BAD,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD
+};
+#undef BAD
+
 /* 'Private' declarations */
 inline void a3_to_a4(unsigned char *a4, unsigned char *a3);
-inline void a4_to_a3(unsigned char *a3, unsigned char *a4);
-inline unsigned char b64_lookup(char c);
 
 int base64_encode(char *output, char *input, int input_len)
 {
@@ -57,59 +77,82 @@ int base64_encode(char *output, char *input, int input_len)
     return enc_len;
 }
 
-int base64_decode(char *output, char *input, int input_len)
+/**
+ * Index of the first character in input that isn't a base64 digit
+ */
+int base64_invalid_index(const char *input, int input_len)
 {
-    int i = 0, j = 0;
-    int dec_len = 0;
-    unsigned char a3[3];
-    unsigned char a4[4];
-
-    while (input_len--)
+    int i = 0;
+    while ((i < input_len) && (pgm_read_byte(&b64_values[(uint8_t)input[i]]) != 0xFF))
     {
-        if (*input == '=')
-        {
-            break;
-        }
-
-        a4[i++] = *(input++);
-        if (i == 4)
-        {
-            for (i = 0; i < 4; i++)
-            {
-                a4[i] = b64_lookup(a4[i]);
-            }
+        i++;
+    }
+    return i;
+}
 
-            a4_to_a3(a3, a4);
+int base64_decode(char *output, const char *input, int input_len)
+{
+    uint8_t *out = (uint8_t *)output;
+    int i = 0;
 
-            for (i = 0; i < 3; i++)
-            {
-                output[dec_len++] = a3[i];
-            }
-            i = 0;
-        }
+    // Padding is only looked for at the end, anywhere else it is invalid
+    while ((input_len > 0) && (input[input_len - 1] == '='))
+    {
+        input_len--;
     }
 
-    if (i)
+    // 4 digits at a time, read as one 32 bit word (little endian), making 3 bytes.
+    // Invalid digits look up as 0xFF, so one test of the four values validates them all.
+    for (; i + 4 <= input_len; i += 4)
     {
-        for (j = i; j < 4; j++)
+        uint32_t word;
+        memcpy(&word, input + i, 4);
+        const uint32_t a = pgm_read_byte(&b64_values[word & 0xFF]);
+        const uint32_t b = pgm_read_byte(&b64_values[(word >> 8) & 0xFF]);
+        const uint32_t c = pgm_read_byte(&b64_values[(word >> 16) & 0xFF]);
+        const uint32_t d = pgm_read_byte(&b64_values[word >> 24]);
+        if ((a | b | c | d) & 0x80)
         {
-            a4[j] = '\0';
+            return -1 - (i + base64_invalid_index(input + i, 4));
         }
+        const uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = triple >> 16;
+        out[1] = triple >> 8;
+        out[2] = triple;
+        out += 3;
+    }
 
-        for (j = 0; j < 4; j++)
+    // 2 or 3 leftover digits make 1 or 2 bytes, a single leftover digit makes none
+    if (i < input_len)
+    {
+        uint32_t triple = 0;
+        int digits = 0;
+        for (; i < input_len; i++, digits++)
         {
-            a4[j] = b64_lookup(a4[j]);
+            const uint8_t value = pgm_read_byte(&b64_values[(uint8_t)input[i]]);
+            if (value & 0x80)
+            {
+                return -1 - i;
+            }
+            triple |= (uint32_t)value << (18 - 6 * digits);
         }
-
-        a4_to_a3(a3, a4);
-
-        for (j = 0; j < i - 1; j++)
+        for (int byte = 0; byte < digits - 1; byte++)
         {
-            output[dec_len++] = a3[j];
+            *out++ = triple >> (16 - 8 * byte);
         }
     }
-    output[dec_len] = '\0';
-    return dec_len;
+    return out - (uint8_t *)output;
+}
+
+int base64_validate(const char *input, int input_len)
+{
+    // Padding is only accepted at the end, as in base64_decode
+    while ((input_len > 0) && (input[input_len - 1] == '='))
+    {
+        input_len--;
+    }
+    const int invalid = base64_invalid_index(input, input_len);
+    return (invalid < input_len) ? -1 - invalid : 0;
 }
 
 int base64_enc_len(int plain_len)
@@ -137,25 +180,3 @@ inline void a3_to_a4(unsigned char *a4, unsigned char *a3)
     a4[2] = ((a3[1] & 0x0f) << 2) + ((a3[2] & 0xc0) >> 6);
     a4[3] = (a3[2] & 0x3f);
 }
-
-inline void a4_to_a3(unsigned char *a3, unsigned char *a4)
-{
-    a3[0] = (a4[0] << 2) + ((a4[1] & 0x30) >> 4);
-    a3[1] = ((a4[1] & 0xf) << 4) + ((a4[2] & 0x3c) >> 2);
-    a3[2] = ((a4[2] & 0x3) << 6) + a4[3];
-}
-
-inline unsigned char b64_lookup(char c)
-{
-    if (c >= 'A' && c <= 'Z')
-        return c - 'A';
-    if (c >= 'a' && c <= 'z')
-        return c - 71;
-    if (c >= '0' && c <= '9')
-        return c + 4;
-    if (c == '+')
-        return 62;
-    if (c == '/')
-        return 63;
-    return -1;
-}
@@ -28,21 +28,42 @@ int base64_encode(char *output, char *input, int input_len);
 
 /* base64_decode:
  * 		Description:
- * 			Decode a base64 encoded string into bytes
+ * 			Decode a base64 encoded string into bytes, validating it in the
+ * 			same pass. 4 digits are read at a time as one word and looked up
+ * 			in a 256 entry table.
  * 		Parameters:
  * 			output: the output buffer for the decoding,
- * 					stores the decoded binary
+ * 					stores the decoded binary, it is not null terminated
  * 			input: the input buffer for the decoding,
- * 				   stores the base64 string to be decoded
+ * 				   stores the base64 string to be decoded, may be output
  * 			input_len: the length of the input buffer, in bytes
  * 		Return value:
- * 			Returns the length of the decoded string
+ * 			Returns the length of the decoded bytes, or -1 - the index of the
+ * 			first character that isn't a base64 digit, in which case the
+ * 			bytes before it have already been written
  * 		Requirements:
- * 			1. output must not be null or empty
+ * 			1. output must have room for base64_dec_len() bytes
  * 			2. input must not be null
  * 			3. input_len must be greater than or equal to 0
  */
-int base64_decode(char *output, char *input, int input_len);
+int base64_decode(char *output, const char *input, int input_len);
+
+/* base64_validate:
+ * 		Description:
+ * 			Check a base64 encoded string without decoding it, so that
+ * 			callers decoding into a destination they can't roll back
+ * 			write nothing when it is invalid
+ * 		Parameters:
+ * 			input: the base64 string to be checked
+ * 			input_len: the length of the input buffer, in bytes
+ * 		Return value:
+ * 			Returns 0 if base64_decode would accept it, or -1 - the index
+ * 			of the first character that isn't a base64 digit
+ * 		Requirements:
+ * 			1. input must not be null
+ * 			2. input_len must be greater than or equal to 0
+ */
+int base64_validate(const char *input, int input_len);
 
 /* base64_enc_len:
  * 		Description:
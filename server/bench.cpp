@@ -0,0 +1,161 @@
+#include "bench.h"
+#include "b64.h"
+#include "gcode.h"
+#include "panel.h"
+#include "correction.h"
+#include "queue.h"
+#include "utility.h"
+#include "serial.h"
+#include "macros.h"
+
+// Defined in server.ino
+int validate_serial_special_fields(char *command, uint8_t checksum, int expected_checksum);
+
+const int bench_sizes[BENCH_SIZES] = {4, 16, 64, 256, 1024, 1464};
+
+#define BENCH_PREFIX "N1 M2600 Q0 S0 V"
+
+/**
+ * Fill line with an M2600 line whose payload is payload_len base64 characters.
+ * Return the length of the line
+ */
+int bench_line(char *line, char *raw, int payload_len) {
+    const int prefix_len = strlen(BENCH_PREFIX);
+    const int raw_len = payload_len / 4 * 3;
+    for (int i = 0; i < raw_len; i++) {
+        raw[i] = (char)(i * 37 + 11);
+    }
+    strcpy(line, BENCH_PREFIX);
+    base64_encode(line + prefix_len, raw, raw_len);
+    return prefix_len + payload_len;
+}
+
+int bench_kernels(bench_report_t report, long budget) {
+    const int saved_pixels_set = pixels_set;
+    const long saved_this_linenum = this_linenum;
+    PanelSnapshot saved_panel;
+    int error_code = save_panel(0, &saved_panel);
+    if (error_code) {
+        return error_code;
+    }
+
+    for (int s = 0; s < BENCH_SIZES; s++) {
+        const int payload_len = bench_sizes[s];
+        const int line_len = strlen(BENCH_PREFIX) + payload_len;
+        const int decoded_len = payload_len / 4 * 3;
+        const int pixels = decoded_len / 3;
+        const int panel_pixels = MIN(pixels, panel_info[0]);
+        const int arena_size = (QUEUE_RECORD_SIZE(line_len) + 2 * sizeof(queue_record_t)) & ~(sizeof(queue_record_t) - 1);
+        if (line_len >= MAX_CMD_SIZE) {
+            break;
+        }
+
+        // The scratch arena first so it is aligned, then the line, the decoded payload with room for a terminator,
+        // and the corrected pixels
+        const int work_size = arena_size + (line_len + 1) + (decoded_len + 1) + panel_pixels * (int)sizeof(CRGB);
+        char *arena = (char *)malloc(work_size);
+        if (!arena) {
+            restore_panel(0, &saved_panel);
+            pixels_set = saved_pixels_set;
+            SNPRINTF_MSG_PSTR("malloc failed for benchmark: %d bytes", work_size);
+            return 2;
+        }
+        char *line = arena + arena_size;
+        char *decoded = line + line_len + 1;
+        CRGB *corrected = (CRGB *)(decoded + decoded_len + 1);
+        bench_line(line, decoded, payload_len);
+        char *payload = line + line_len - payload_len;
+
+        const long iterations = max(1L, budget / payload_len);
+        unsigned long started;
+
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            base64_decode(decoded, payload, payload_len);
+        }
+        report("b64", payload_len, pixels, iterations, micros() - started);
+
+        const long saved_linenum = parser.linenum;
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            parser.parse(line);
+        }
+        report("parse", line_len, pixels, iterations, micros() - started);
+
+        // Summed into a volatile so the lookups aren't optimized away
+        volatile int seen_len = 0;
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            if (parser.seen('V')) {
+                seen_len += parser.arg_str_len;
+            }
+        }
+        report("seen", line_len, pixels, iterations, micros() - started);
+        parser.linenum = saved_linenum;
+
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            validate_serial_special_fields(line, 0, 0);
+        }
+        report("validate", line_len, pixels, iterations, micros() - started);
+        this_linenum = saved_this_linenum;
+
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            for (int pixel = 0; pixel < panel_pixels; pixel++) {
+                set_panel_pixel_RGB(0, pixel, decoded + pixel * 3);
+            }
+        }
+        report("rgb", panel_pixels * 3, panel_pixels, iterations, micros() - started);
+
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            set_panel_HSV(0, decoded, panel_info[0] - panel_pixels);
+        }
+        report("hsv", panel_pixels * 3, panel_pixels, iterations, micros() - started);
+
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            correct_pixels(0, corrected, panels[0], panel_pixels);
+        }
+        report("correct", panel_pixels * 3, panel_pixels, iterations, micros() - started);
+
+        // Swap in a scratch arena with room for one record, leaving the queue and any reservation alone
+        char *saved_queue = command_queue;
+        const int saved_size = queue_size, saved_max_cmd_size = queue_max_cmd_size;
+        const int saved_head = queue_head, saved_tail = queue_tail, saved_count = queue_count;
+        const int saved_reserved = queue_reserved;
+        const void *saved_owner = queue_reserved_owner;
+        command_queue = arena;
+        queue_size = arena_size;
+        queue_max_cmd_size = line_len + 1;
+        queue_clear();
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            enqueue_command(line);
+            queue_advance_read();
+        }
+        unsigned long elapsed = micros() - started;
+        command_queue = saved_queue;
+        queue_size = saved_size;
+        queue_max_cmd_size = saved_max_cmd_size;
+        queue_head = saved_head;
+        queue_tail = saved_tail;
+        queue_count = saved_count;
+        queue_reserved = saved_reserved;
+        queue_reserved_owner = saved_owner;
+        report("enqueue", line_len, pixels, iterations, elapsed);
+
+        uint16_t crc = 0;
+        started = micros();
+        for (long i = 0; i < iterations; i++) {
+            crc16(&crc, line, line_len);
+        }
+        report("crc16", line_len, pixels, iterations, micros() - started);
+
+        free(arena);
+    }
+    restore_panel(0, &saved_panel);
+    pixels_set = saved_pixels_set;
+    return 0;
+}
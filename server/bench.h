@@ -0,0 +1,48 @@
+/**
+ * Kernel Benchmarks
+ * Times each kernel on the hot path on its own, over payloads from a few
+ * characters to a full line, so that changes to one can be measured without
+ * the noise of the serial link and the LEDs.
+ *
+ * Each kernel is run over an M2600 line carrying a base64 payload of each
+ * size in bench_sizes, writing to panel 0:
+ *
+ *   b64      base64_decode() of the payload
+ *   parse    GCodeParser::parse() of the line
+ *   seen     GCodeParser::seen() of the payload parameter, the last on the line
+ *   validate validate_serial_special_fields() of the line
+ *   rgb      set_panel_pixel_RGB() for each decoded pixel
+ *   hsv      set_panel_HSV() over as many pixels
+ *   correct  correct_pixels() over as many pixels into a scratch buffer, as done when they are shown
+ *   enqueue  enqueue_command() of the line, into a scratch arena
+ *   crc16    crc16() of the line
+ *
+ * The queue, parser linenum, pixel count, and panel 0 are left as they were.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <Arduino.h>
+#include "config.h"
+
+// Number of payload sizes benchmarked
+#define BENCH_SIZES 6
+
+// Payload sizes in base64 characters, the largest fills a line of MAX_CMD_SIZE
+extern const int bench_sizes[BENCH_SIZES];
+
+/**
+ * Called with the result of each kernel at each size: the bytes it consumes
+ * and the pixels it handles per iteration, the number of iterations, and the
+ * total time they took in us.
+ */
+typedef void (*bench_report_t)(const char *kernel, int bytes, int pixels, long iterations, unsigned long elapsed);
+
+/**
+ * Run every kernel at each size, for max(1, budget / payload size) iterations.
+ * Return error code, if there was not enough SRAM for a size. Sizes before it are still reported.
+ */
+int bench_kernels(bench_report_t report, long budget);
+
+#endif /* __BENCH_H__ */
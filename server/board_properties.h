@@ -49,8 +49,19 @@
 #elif defined(__MK66FX1M0__) /* Teensy 3.6 (Cortex-M4F) */
 #define DETECTED_BOARD "MK66FX1M0"
 #define SRAM_SIZE 262144
+// Host build, the default HOST_SRAM_SIZE of host/shims/arduino.cpp
+#elif defined(HOST_BUILD)
+#define DETECTED_BOARD "HOST"
+#define SRAM_SIZE 49152
 #else
 // Assume we're on an Arduino Uno
 #define DETECTED_BOARD "NONE"
 #define SRAM_SIZE 2048
 #endif
+
+// Cortex-M4 Teensies have a DWT cycle counter, which counts at F_CPU
+#if defined(__MK20DX256__) || defined(__MK20DX128__) || defined(__MK64FX512__) || defined(__MK66FX1M0__)
+#define HAS_CYCLE_COUNTER 1
+#else
+#define HAS_CYCLE_COUNTER 0
+#endif
@@ -0,0 +1,117 @@
+#include "capacity.h"
+#include "panel.h"
+#include "correction.h"
+#include "gcode.h"
+#include "frame.h"
+#include "b64.h"
+#include "utility.h"
+#include "macros.h"
+
+// Pixels decoded at a time when measuring, and how many times
+#define CAPACITY_CHUNK_PIXELS 64
+#define CAPACITY_ITERATIONS 16
+
+unsigned long led_clock_out_us(int pixels) {
+    #if NEEDS_CLK
+        // APA102: 32 bit start frame, 32 bits per LED, and half a bit per LED of end frame
+        return (32UL + 32UL * pixels + pixels / 2) / APA_DATA_RATE;
+    #else
+        // WS2812: 24 bits per LED at 800 kHz, then a 50 us latch
+        return 30UL * pixels + 50;
+    #endif
+}
+
+long frame_wire_bytes(int encoding) {
+    long bytes = 0;
+    for (int panel = 0; panel < panel_count; panel++) {
+        int pixels = panel_info[panel];
+        if (encoding == ENCODING_BINARY) {
+            const int max_pixels = (MAX_CMD_SIZE - 1 - BINARY_FRAME_OVERHEAD) / 3;
+            for (int offset = 0; offset < pixels; offset += max_pixels) {
+                const int payload_len = 3 * MIN(max_pixels, pixels - offset);
+                // COBS adds a byte for every 254
+                bytes += BINARY_FRAME_OVERHEAD + payload_len + (FRAME_HEADER_LEN + payload_len + FRAME_CRC_LEN) / 254;
+            }
+        } else {
+            const int max_pixels = (MAX_CMD_SIZE - 1 - TEXT_LINE_OVERHEAD) / 4;
+            for (int offset = 0; offset < pixels; offset += max_pixels) {
+                bytes += TEXT_LINE_OVERHEAD + 4 * MIN(max_pixels, pixels - offset);
+            }
+        }
+    }
+    bytes += (encoding == ENCODING_BINARY) ? BINARY_FRAME_OVERHEAD : TEXT_SHOW_BYTES;
+    return bytes;
+}
+
+long measure_decode_ns(int encoding) {
+    const int pixels = MIN(CAPACITY_CHUNK_PIXELS, panel_info[0]);
+    const int saved_pixels_set = pixels_set;
+    char encoded[CAPACITY_CHUNK_PIXELS * 4 + 1];
+    char decoded[CAPACITY_CHUNK_PIXELS * 3 + 1];
+    CRGB corrected[CAPACITY_CHUNK_PIXELS];
+    int encoded_len;
+    // Never zero, so the binary chunk is a single COBS block
+    for (int i = 0; i < pixels * 3; i++) {
+        decoded[i] = (char)((i * 37 + 11) | 1);
+    }
+    if (encoding == ENCODING_BINARY) {
+        encoded[0] = pixels * 3 + 1;
+        memcpy(encoded + 1, decoded, pixels * 3);
+        encoded_len = pixels * 3 + 1;
+    } else {
+        encoded_len = base64_encode(encoded, decoded, pixels * 3);
+    }
+
+    // Panel 0 is written to and put back afterwards
+    PanelSnapshot saved_panel;
+    if (save_panel(0, &saved_panel)) {
+        return -1;
+    }
+    unsigned long started = micros();
+    for (int i = 0; i < CAPACITY_ITERATIONS; i++) {
+        if (encoding == ENCODING_BINARY) {
+            uint16_t checksum = 0;
+            cobs_decode((uint8_t *)decoded, (const uint8_t *)encoded, encoded_len);
+            crc16(&checksum, decoded, pixels * 3);
+        } else {
+            base64_decode(decoded, encoded, encoded_len);
+        }
+        write_panel_pixels(2600, 0, 0, decoded, pixels);
+        correct_pixels(0, corrected, panels[0], pixels);
+    }
+    unsigned long elapsed = micros() - started;
+    restore_panel(0, &saved_panel);
+    pixels_set = saved_pixels_set;
+    return (long)(elapsed * 1000 / (CAPACITY_ITERATIONS * pixels));
+}
+
+void estimate_capacity(CapacityEstimate *estimate, int encoding, long baud, long decode_ns) {
+    estimate->frame_bytes = frame_wire_bytes(encoding);
+    // 10 bits per byte with the start and stop bits
+    estimate->link_us = baud ? (unsigned long)((estimate->frame_bytes * 10LL * 1000000) / baud) : 0;
+    estimate->decode_us = (unsigned long)((long long)pixel_count * decode_ns / 1000);
+    estimate->clock_out_us = 0;
+    for (int panel = 0; panel < panel_count; panel++) {
+        estimate->clock_out_us += led_clock_out_us(panel_info[panel]);
+    }
+
+    bool pipelined = false;
+    #if PIPELINED_SHOW
+        pipelined = double_buffered;
+    #endif
+    if (pipelined) {
+        estimate->frame_us = max(estimate->link_us, estimate->decode_us + estimate->clock_out_us);
+    } else {
+        estimate->frame_us = max(estimate->link_us, estimate->decode_us) + estimate->clock_out_us;
+    }
+
+    estimate->bottleneck = "link";
+    unsigned long longest = estimate->link_us;
+    if (estimate->decode_us > longest) {
+        estimate->bottleneck = "decode";
+        longest = estimate->decode_us;
+    }
+    if (estimate->clock_out_us > longest) {
+        estimate->bottleneck = "leds";
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * Capacity Planner
+ * Estimates the frame rate the board can reach when every pixel of every
+ * panel is sent each frame, and what limits it:
+ *
+ *   link    the time the frame takes to arrive at the baud rate, in the chosen encoding
+ *   decode  the time the board takes to decode the frame into the panels and colour correct it
+ *   leds    the time the LEDs take to clock out
+ *
+ * The link and the LEDs are modelled from the configuration, the decode time
+ * is measured on the board itself. With PIPELINED_SHOW, the LEDs clock out
+ * while the next frame arrives, so a frame takes as long as the slower of the
+ * link and decoding plus clocking out. Otherwise the link waits for the show.
+ * tools/capacity.py uses the same model.
+ */
+
+#ifndef __CAPACITY_H__
+#define __CAPACITY_H__
+
+#include <Arduino.h>
+#include "config.h"
+
+// Frames sent as M2600 lines, base 64 encoded RGB
+#define ENCODING_TEXT 0
+// Frames sent as binary frames, see frame.h
+#define ENCODING_BINARY 1
+
+// Bytes of an M2600 line besides the payload, e.g. "N12345 M2600 Q0 S300 V" and "*XX\n"
+#define TEXT_LINE_OVERHEAD 26
+// Bytes of the line that shows the frame, e.g. "N12345 M2610*XX\n"
+#define TEXT_SHOW_BYTES 16
+// Bytes of a binary frame besides the payload: delimiters, COBS code, header and crc
+#define BINARY_FRAME_OVERHEAD 11
+
+typedef struct {
+    long frame_bytes;               // Bytes sent over the link per frame
+    unsigned long link_us;          // Time the frame takes to arrive, 0 if the baud rate is not limited
+    unsigned long decode_us;        // Time taken to decode the frame
+    unsigned long clock_out_us;     // Time the LEDs take to clock out
+    unsigned long frame_us;         // Time per frame
+    const char *bottleneck;         // "link", "decode" or "leds"
+} CapacityEstimate;
+
+/**
+ * Time in us a panel of pixels takes to clock out, for PANEL_TYPE
+ */
+unsigned long led_clock_out_us(int pixels);
+
+/**
+ * Bytes sent over the link to set every pixel of every panel and show them
+ */
+long frame_wire_bytes(int encoding);
+
+/**
+ * Time the board takes to decode and colour correct a pixel in the given encoding in ns,
+ * measured by decoding a chunk into panel 0, which is put back afterwards.
+ * Return -1 if panel 0 couldn't be saved
+ */
+long measure_decode_ns(int encoding);
+
+/**
+ * Estimate the time per frame for the panels, encoding and baud rate (0 for native USB),
+ * given the decode time per pixel in ns.
+ */
+void estimate_capacity(CapacityEstimate *estimate, int encoding, long baud, long decode_ns);
+
+#endif /* __CAPACITY_H__ */
@@ -10,6 +10,13 @@ unsigned long stopwatch_started_0;
 unsigned long stopwatch_started_1;
 unsigned long stopwatch_started_2;
 
+long clock_drift_ppb;
+bool clock_synced;
+unsigned long local_micros_last;
+unsigned long local_micros_high;
+int64_t clock_base;             // Synced clock minus local clock at clock_sync_local
+uint64_t clock_sync_local;      // local_micros() when the clock was last set
+
 // TODO: make appropriate functions inline and put in header
 
 int init_clock() {
@@ -20,6 +27,10 @@ int init_clock() {
     last_loop_debug = 0;
     last_loop_idle = 0;
     last_cmd_rx = 0;
+    clock_drift_ppb = 0;
+    clock_synced = false;
+    clock_sync_local = local_micros();
+    clock_base = -(int64_t)clock_sync_local;
     return 0;
 }
 
@@ -27,6 +38,55 @@ unsigned long delta_started() {
     return millis() - t_started;
 }
 
+uint64_t local_micros() {
+    unsigned long now = micros();
+    if (now < local_micros_last) {
+        local_micros_high++;
+    }
+    local_micros_last = now;
+    return ((uint64_t)local_micros_high << 32) | now;
+}
+
+uint64_t local_micros_from(unsigned long local_low) {
+    uint64_t now = local_micros();
+    return now - (unsigned long)((unsigned long)now - local_low);
+}
+
+/**
+ * The synced clock at local_us, corrected for drift since the last sync
+ */
+uint64_t clock_at(uint64_t local_us) {
+    int64_t elapsed = local_us - clock_sync_local;
+    return local_us + clock_base + elapsed * clock_drift_ppb / 1000000000LL;
+}
+
+uint64_t clock_micros() {
+    return clock_at(local_micros());
+}
+
+unsigned long clock_millis() {
+    return (unsigned long)(clock_micros() / 1000);
+}
+
+void clock_sync(uint64_t local_us, uint64_t host_us) {
+    int64_t error = host_us - clock_at(local_us);
+    int64_t elapsed = local_us - clock_sync_local;
+    if (!clock_synced || error > CLOCK_STEP_LIMIT * 1000LL || error < -CLOCK_STEP_LIMIT * 1000LL) {
+        // The host clock is new to us, so there is nothing to measure drift against
+        clock_drift_ppb = 0;
+    } else if (elapsed >= CLOCK_DRIFT_MIN_INTERVAL * 1000LL) {
+        // Drift since the last sync, averaged with the estimate to smooth out sync noise
+        int64_t drift = ((int64_t)(host_us - local_us) - clock_base) * 1000000000LL / elapsed;
+        clock_drift_ppb += (long)((drift - clock_drift_ppb) / 2);
+    }
+    clock_base = host_us - local_us;
+    clock_sync_local = local_us;
+    clock_synced = true;
+    #if DEBUG
+        SER_SNPRINTF_COMMENT_PSTR("CLK: -> error: %ld us, drift: %ld ppb", (long)error, clock_drift_ppb);
+    #endif
+}
+
 void stopwatch_start_0() {
     stopwatch_started_0 = micros();
 }
@@ -44,9 +104,9 @@ long stopwatch_stop_1() {
 }
 
 void stopwatch_start_2() {
-    stopwatch_started_1 = micros();
+    stopwatch_started_2 = micros();
 }
 
 long stopwatch_stop_2() {
-    return micros() - stopwatch_started_1;
+    return micros() - stopwatch_started_2;
 }
@@ -10,6 +10,43 @@ extern unsigned long last_cmd_rx;
 
 int init_clock();
 unsigned long delta_started();
+
+/**
+ * Synced Clock
+ * A clock in us that hosts can set to their own clock, so that timed frames
+ * line up across controllers. It runs from boot until it is first set.
+ * Each setting after the first also estimates how fast micros() drifts from
+ * the host clock, which is corrected for until the next setting.
+ */
+
+// Drift of micros() from the host clock, in parts per billion
+extern long clock_drift_ppb;
+// Whether the clock has been set by a host
+extern bool clock_synced;
+
+/**
+ * micros() extended to 64 bits, must be called at least once every 71 minutes,
+ * which loop() does
+ */
+uint64_t local_micros();
+
+/**
+ * Reconstruct the local_micros() value from its low 32 bits, if it was within the last 71 minutes
+ */
+uint64_t local_micros_from(unsigned long local_low);
+
+uint64_t clock_micros();
+
+/**
+ * The synced clock in ms, wrapping at 32 bits
+ */
+unsigned long clock_millis();
+
+/**
+ * Set the synced clock so that it read host_us at local_us
+ */
+void clock_sync(uint64_t local_us, uint64_t host_us);
+
 void stopwatch_start_0();
 long stopwatch_stop_0();
 void stopwatch_start_1();
@@ -0,0 +1,85 @@
+#include "compress.h"
+#include "panel.h"
+#include "serial.h"
+#include "debug.h"
+
+int compressed_pixels(const char *data, int len, int max_pixels) {
+    int pixels = 0;
+    int index = 0;
+    while (index < len) {
+        const uint8_t control = data[index++];
+        if (control < COMPRESS_RUN) {
+            index += (control + 1) * 3;
+            pixels += control + 1;
+            if (index > len) {
+                SNPRINTF_MSG_PSTR("compressed payload ends in the middle of a literal at pixel %d", pixels);
+                return -1;
+            }
+        } else if (control < COMPRESS_REF) {
+            if (!pixels) {
+                STRNCPY_MSG_PSTR("compressed payload starts with a run");
+                return -1;
+            }
+            pixels += control - COMPRESS_RUN + 1;
+        } else {
+            if (index >= len) {
+                STRNCPY_MSG_PSTR("compressed payload ends before a reference distance");
+                return -1;
+            }
+            const int distance = (uint8_t)data[index++] + 1;
+            if (distance > pixels) {
+                SNPRINTF_MSG_PSTR(
+                    "compressed payload reference at pixel %d goes back %d pixels", pixels, distance
+                );
+                return -1;
+            }
+            pixels += control - COMPRESS_REF + 2;
+        }
+        if (pixels > max_pixels) {
+            SNPRINTF_MSG_PSTR(
+                "compressed payload too long for panel. pixels: %d, max_pixels: %d", pixels, max_pixels
+            );
+            return -1;
+        }
+    }
+    return pixels;
+}
+
+int write_panel_compressed(int panel, int pixel_offset, const char *data, int len) {
+    const int pixels = compressed_pixels(data, len, panel_info[panel] - pixel_offset);
+    if (pixels < 0) {
+        return 14;
+    }
+
+    mark_panel_dirty(panel, pixel_offset, pixel_offset + pixels);
+    CRGB *pixels_out = panels[panel] + pixel_offset;
+    int pixel = 0;
+    int index = 0;
+    char pixel_data[3];
+    while (index < len) {
+        const uint8_t control = data[index++];
+        int count;
+        if (control < COMPRESS_RUN) {
+            for (count = control + 1; count; count--) {
+                // Copied so that the payload is left as it is
+                memcpy(pixel_data, data + index, 3);
+                set_panel_pixel_RGB(panel, pixel_offset + pixel++, pixel_data);
+                index += 3;
+            }
+            continue;
+        }
+        int distance = 1;
+        if (control < COMPRESS_REF) {
+            count = control - COMPRESS_RUN + 1;
+        } else {
+            count = control - COMPRESS_REF + 2;
+            distance = (uint8_t)data[index++] + 1;
+        }
+        pixels_set += count;
+        // References may overlap the pixels they write, so copy forwards one pixel at a time
+        for (; count; count--, pixel++) {
+            pixels_out[pixel] = pixels_out[pixel - distance];
+        }
+    }
+    return 0;
+}
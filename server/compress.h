@@ -0,0 +1,40 @@
+/**
+ * Compressed Pixel Payloads
+ * Decodes run length / back reference compressed RGB pixels straight into a panel.
+ *
+ * The payload is a sequence of tokens, each starting with a control byte:
+ *
+ *   0x00 - 0x7F  literal:   (c + 1) RGB pixels follow, 3 bytes each
+ *   0x80 - 0xBF  run:       repeat the previous pixel (c - 0x7F) times
+ *   0xC0 - 0xFF  reference: copy (c - 0xBE) pixels from the distance byte d that follows,
+ *                           starting (d + 1) pixels back
+ *
+ * Runs and references only reach back to pixels decoded from the same
+ * payload. They are copied within the panel, so decoding takes no RAM beyond
+ * the panel itself.
+ */
+
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+#include <Arduino.h>
+
+#include "config.h"
+
+#define COMPRESS_RUN 0x80
+#define COMPRESS_REF 0xC0
+
+/**
+ * Check a compressed payload and work out how many pixels it decodes to.
+ * Return the number of pixels, or -1 if it is malformed or decodes to more than max_pixels
+ */
+int compressed_pixels(const char *data, int len, int max_pixels);
+
+/**
+ * Decode a compressed payload into a panel, starting at pixel_offset.
+ * The payload is checked before any pixel is written, and is not modified.
+ * Return error code
+ */
+int write_panel_compressed(int panel, int pixel_offset, const char *data, int len);
+
+#endif /* __COMPRESS_H__ */
@@ -14,10 +14,19 @@
 #define DEBUG_SERIAL 0
 #define DEBUG_EEPROM 0
 
+// Time each stage of the command path into histograms, queried with P2622. Takes 816 bytes of SRAM.
+#define LATENCY_HISTOGRAMS 1
+// Events kept in the trace ring, dumped with P2623. Each takes 8 bytes of SRAM, must be a power of 2, 0 to disable.
+// Defaults to 256 (2 KB) on boards with at least 32 KB of SRAM, 32 (256 bytes) with 8 KB, and 0 below that,
+// see the end of this file.
+// #define TRACE_EVENTS 256
+
 /* Command processing flags */
 #define REQUIRE_CHECKSUM 0
 #define REQUIRE_CONSECUTIVE_LINENUM 0
 #define REPLY_OK 0
+/* Decode M2600 / M2601 payloads while the line is being received */
+#define STREAM_PIXEL_PAYLOADS 1
 
 /* Display rainbows until receive GCode */
 #define RAINBOWS_UNTIL_GCODE 1
@@ -31,8 +40,50 @@
 // Maximum command length
 #define MAX_CMD_SIZE 1500
 
-// Number of commands in the queue
-#define MAX_QUEUE_LEN 10
+// Number of bytes read from a command source at once
+#define INGEST_CHUNK_SIZE 64
+
+// Free SRAM left for the stack and heap when the command queue is sized at boot
+#define QUEUE_SRAM_RESERVE 1024
+// Upper and lower bounds on the size of the command queue in bytes
+#define QUEUE_MAX_SIZE 16384
+#define QUEUE_MIN_SIZE 128
+
+// Lines that can be kept while a missing line is resent (at most this many lines ahead of it)
+// 0 to always resend everything after a missing line
+#define RESEND_WINDOW_LINES 16
+// Bytes allocated for the lines that are kept
+#define RESEND_WINDOW_SIZE 4096
+
+// Keep a back buffer for each panel that commands write to, copied to the LEDs when a frame is shown.
+// Falls back to writing straight to the LEDs if there isn't enough SRAM.
+#define DOUBLE_BUFFER 1
+
+// Only clock out the panels whose pixels changed when showing all panels (M2610, M2613)
+#define SHOW_CHANGED_ONLY 0
+
+// Clock out one panel per loop, receiving commands in between, instead of blocking for all of them.
+// Needs double buffering.
+#define PIPELINED_SHOW 1
+
+// Where shown pixels go at boot, OUTPUT_FASTLED, OUTPUT_NULL or OUTPUT_RECORDING (see output.h)
+#define OUTPUT_BACKEND OUTPUT_FASTLED
+// Panels shown that the recording backend keeps, each takes 8 bytes
+#define OUTPUT_RECORD_SIZE 64
+
+// Frames that can wait to be shown at a given time, each takes 3 bytes per pixel.
+// 0 to show timed frames as soon as they arrive.
+#define JITTER_BUFFER_FRAMES 4
+// Frames shown more than this many ms after their time are counted as late
+#define JITTER_LATE_MARGIN 1
+
+// Clock syncs at least this many ms apart update the drift estimate
+#define CLOCK_DRIFT_MIN_INTERVAL 10000
+// Clock syncs that move the clock by more than this many ms are taken as a new host clock, and reset the drift estimate
+#define CLOCK_STEP_LIMIT 1000
+
+// Entries in each palette, a palette takes 3 bytes per entry once it is uploaded
+#define PALETTE_SIZE 256
 
 // TIMING
 #define LOOP_WAIT_PERIOD 0
@@ -52,4 +103,14 @@
 #include "panel_config.h"
 #include "board_properties.h"
 
+#ifndef TRACE_EVENTS
+    #if SRAM_SIZE >= 32768
+        #define TRACE_EVENTS 256
+    #elif SRAM_SIZE >= 8192
+        #define TRACE_EVENTS 32
+    #else
+        #define TRACE_EVENTS 0
+    #endif
+#endif
+
 #endif /* __CONFIG_H__ */
@@ -0,0 +1,166 @@
+#include "correction.h"
+#include "panel.h"
+#include "serial.h"
+#include "debug.h"
+
+CorrectionSettings global_correction;
+CorrectionSettings panel_corrections[MAX_PANELS];
+
+CorrectionTable global_table;
+CorrectionTable *panel_tables[MAX_PANELS];
+
+// Built in gamma correction, used when the gamma setting is 0
+const uint8_t PROGMEM gammaR[] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,
+    1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,
+    2,  2,  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,
+    5,  5,  5,  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,
+    9,  9, 10, 10, 10, 11, 11, 11, 12, 12, 12, 13, 13, 14, 14, 14,
+   15, 15, 16, 16, 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22,
+   23, 24, 24, 25, 25, 26, 27, 27, 28, 29, 29, 30, 31, 31, 32, 33,
+   33, 34, 35, 36, 36, 37, 38, 39, 40, 40, 41, 42, 43, 44, 45, 46,
+   46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61,
+   62, 63, 65, 66, 67, 68, 69, 70, 71, 73, 74, 75, 76, 78, 79, 80,
+   81, 83, 84, 85, 87, 88, 89, 91, 92, 94, 95, 97, 98, 99,101,102,
+  104,105,107,109,110,112,113,115,116,118,120,121,123,125,127,128,
+  130,132,134,135,137,139,141,143,145,146,148,150,152,154,156,158,
+  160,162,164,166,168,170,172,174,177,179,181,183,185,187,190,192,
+  194,196,199,201,203,206,208,210,213,215,218,220,223,225,227,230 };
+
+const uint8_t PROGMEM gammaG[] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
+    1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
+    2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
+    5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
+   10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
+   17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
+   25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
+   37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
+   51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
+   69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
+   90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
+  115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
+  144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
+  177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
+  215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255 };
+
+
+const uint8_t PROGMEM gammaB[] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,
+    1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,
+    2,  2,  2,  2,  2,  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,
+    4,  4,  5,  5,  5,  5,  5,  6,  6,  6,  6,  6,  7,  7,  7,  8,
+    8,  8,  8,  9,  9,  9, 10, 10, 10, 10, 11, 11, 12, 12, 12, 13,
+   13, 13, 14, 14, 15, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19, 19,
+   20, 20, 21, 22, 22, 23, 23, 24, 24, 25, 25, 26, 27, 27, 28, 28,
+   29, 30, 30, 31, 32, 32, 33, 34, 34, 35, 36, 37, 37, 38, 39, 40,
+   40, 41, 42, 43, 44, 44, 45, 46, 47, 48, 49, 50, 51, 51, 52, 53,
+   54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 69, 70,
+   71, 72, 73, 74, 75, 77, 78, 79, 80, 81, 83, 84, 85, 86, 88, 89,
+   90, 92, 93, 94, 96, 97, 98,100,101,103,104,106,107,109,110,112,
+  113,115,116,118,119,121,122,124,126,127,129,131,132,134,136,137,
+  139,141,143,144,146,148,150,152,153,155,157,159,161,163,165,167,
+  169,171,173,175,177,179,181,183,185,187,189,191,193,196,198,200 };
+
+const uint8_t *const builtin_gamma[3] = {gammaR, gammaG, gammaB};
+
+/**
+ * Mark every pixel of the panels using table to be corrected again on the next show
+ */
+void mark_table_dirty(const CorrectionTable *table) {
+    for (int panel = 0; panel < panel_count; panel++) {
+        if (panel_tables[panel] == table) {
+            mark_panel_dirty(panel, 0, panel_info[panel]);
+        }
+    }
+}
+
+void build_table(CorrectionTable *table, const CorrectionSettings *settings) {
+    uint8_t *channels[3] = {table->r, table->g, table->b};
+    for (int value = 0; value < 256; value++) {
+        float curve = 0;
+        if (settings->gamma) {
+            curve = 255.0 * pow(value / 255.0, settings->gamma / 100.0);
+        }
+        for (int channel = 0; channel < 3; channel++) {
+            if (!settings->gamma) {
+                curve = pgm_read_byte(&builtin_gamma[channel][value]);
+            }
+            const uint32_t scale = (uint32_t)settings->white[channel] * settings->brightness;
+            channels[channel][value] = (uint8_t)((uint32_t)(curve + 0.5) * scale / (255UL * 255UL));
+        }
+    }
+}
+
+void reset_corrections() {
+    #if ENABLE_GAMMA_CORRECTION
+        global_correction.gamma = 0;
+    #else
+        global_correction.gamma = 100;
+    #endif
+    global_correction.brightness = MAX_BRIGHTNESS;
+    global_correction.white[0] = global_correction.white[1] = global_correction.white[2] = 255;
+    set_correction(GLOBAL_CORRECTION, &global_correction);
+}
+
+int set_correction(int panel, const CorrectionSettings *settings) {
+    if (panel == GLOBAL_CORRECTION) {
+        global_correction = *settings;
+        for (int p = 0; p < MAX_PANELS; p++) {
+            if (panel_tables[p] && panel_tables[p] != &global_table) {
+                free(panel_tables[p]);
+            }
+            panel_tables[p] = &global_table;
+            panel_corrections[p] = global_correction;
+        }
+        build_table(&global_table, &global_correction);
+        mark_table_dirty(&global_table);
+        return 0;
+    }
+    if (!has_own_correction(panel)) {
+        panel_tables[panel] = (CorrectionTable *)malloc(sizeof(CorrectionTable));
+        if (!panel_tables[panel]) {
+            panel_tables[panel] = &global_table;
+            SNPRINTF_MSG_PSTR("malloc failed for correction table: %d bytes", (int)sizeof(CorrectionTable));
+            return 2;
+        }
+    }
+    panel_corrections[panel] = *settings;
+    build_table(panel_tables[panel], settings);
+    mark_table_dirty(panel_tables[panel]);
+    return 0;
+}
+
+int set_correction_entries(int panel, int entry_offset, const char *entries, int count) {
+    if (panel != GLOBAL_CORRECTION && !has_own_correction(panel)) {
+        CorrectionTable *own_table = (CorrectionTable *)malloc(sizeof(CorrectionTable));
+        if (!own_table) {
+            SNPRINTF_MSG_PSTR("malloc failed for correction table: %d bytes", (int)sizeof(CorrectionTable));
+            return 2;
+        }
+        // Entries uploaded to the global table are kept
+        memcpy(own_table, &global_table, sizeof(CorrectionTable));
+        panel_tables[panel] = own_table;
+        panel_corrections[panel] = global_correction;
+    }
+    CorrectionTable *table = (panel == GLOBAL_CORRECTION) ? &global_table : panel_tables[panel];
+    memcpy((uint8_t *)table + entry_offset, entries, count);
+    mark_table_dirty(table);
+    return 0;
+}
+
+bool has_own_correction(int panel) {
+    return panel_tables[panel] && panel_tables[panel] != &global_table;
+}
+
+void correct_pixels(int panel, CRGB *dest, const CRGB *src, int count) {
+    const CorrectionTable *table = panel_tables[panel];
+    for (int pixel = 0; pixel < count; pixel++) {
+        dest[pixel].r = table->r[src[pixel].r];
+        dest[pixel].g = table->g[src[pixel].g];
+        dest[pixel].b = table->b[src[pixel].b];
+    }
+}
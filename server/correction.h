@@ -0,0 +1,82 @@
+/**
+ * Colour Correction
+ * Lookup tables that fold gamma, brightness and white balance into one
+ * lookup per channel, applied to the pixels of a panel as they are shown.
+ *
+ * Commands write uncorrected pixels to the panels. When a panel is shown, the
+ * range of pixels written since it was last shown is copied to the shown
+ * buffers through its table, in one pass, so pixels are corrected once
+ * however many times they were written. Single buffered panels are corrected
+ * into the LED buffer only while they are output, then put back as written,
+ * so in every mode the panels hold the pixels as written.
+ *
+ * There is a global table, and each panel can have its own table which is
+ * used instead of the global one, like palettes. Tables are built from their
+ * settings when they are set, or uploaded entry by entry. Changing a table
+ * marks its panels to be corrected again from the pixels as written on the next show.
+ */
+
+#ifndef __CORRECTION_H__
+#define __CORRECTION_H__
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "config.h"
+
+// Panel number of the global table
+#define GLOBAL_CORRECTION -1
+
+// Entries in a table, one for each value of each channel
+#define CORRECTION_ENTRIES (3 * 256)
+
+typedef struct {
+    uint8_t r[256];
+    uint8_t g[256];
+    uint8_t b[256];
+} CorrectionTable;
+
+typedef struct {
+    uint16_t gamma;         // Gamma exponent in hundredths, 0 for the built in gamma tables
+    uint8_t brightness;     // Scale of all channels, 255 for full brightness
+    uint8_t white[3];       // White balance, scale of each channel
+} CorrectionSettings;
+
+// Settings of the global table
+extern CorrectionSettings global_correction;
+
+// Settings of each panel's table, the global settings unless it has its own
+extern CorrectionSettings panel_corrections[MAX_PANELS];
+
+/**
+ * Set the defaults: ENABLE_GAMMA_CORRECTION's built in tables (or none), MAX_BRIGHTNESS,
+ * and no white balance, for all panels.
+ */
+void reset_corrections();
+
+/**
+ * Build the table of a panel from settings, or with GLOBAL_CORRECTION build the
+ * global table and use it for every panel, freeing the panels' own tables.
+ * Return error code
+ */
+int set_correction(int panel, const CorrectionSettings *settings);
+
+/**
+ * Set table entries starting at entry_offset, red entries first, then green, then blue.
+ * panel is a panel number or GLOBAL_CORRECTION. A panel without its own table gets
+ * a copy of the global table first. Parameters must already be validated.
+ * Return error code
+ */
+int set_correction_entries(int panel, int entry_offset, const char *entries, int count);
+
+/**
+ * Whether a panel has its own table
+ */
+bool has_own_correction(int panel);
+
+/**
+ * Copy count pixels from src to dest through the panel's table, src may be dest
+ */
+void correct_pixels(int panel, CRGB *dest, const CRGB *src, int count);
+
+#endif /* __CORRECTION_H__ */
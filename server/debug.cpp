@@ -3,6 +3,7 @@
 #include "debug.h"
 #include "serial.h"
 #include "config.h"
+#include "queue.h"
 
 /**
  * Debug
@@ -17,7 +18,9 @@ int error_code = 0;
 int getFreeSram()
 {
     char top;
-    #ifdef __arm__
+    #if defined(HOST_BUILD)
+        return host_free_sram();
+    #elif defined(__arm__)
         return &top - reinterpret_cast<char*>(sbrk(0));
     #else  // __arm__
         return __brkval ? &top - __brkval : &top - &__bss_end;
@@ -42,6 +45,13 @@ void print_line_response(int linenum, char* message) {
 }
 
 void print_line_ok(int linenum) {
+    if (flow_control_enabled) {
+        // Every line is acked with the free queue capacity so the host can keep the queue full
+        SER_SNPRINTF_ERR_PSTR("N%d: OK C%d B%d", linenum, queue_free_slots(), queue_free_bytes());
+        SERIAL_OBJ.println();
+        SERIAL_OBJ.flush();
+        return;
+    }
     #if REPLY_OK
         SER_SNPRINTF_ERR_PSTR("N%d: OK", linenum);
         SERIAL_OBJ.println();
@@ -20,7 +20,9 @@
 #define DEBUG_GCODE DEBUG
 #endif
 
-#ifdef __arm__
+#if defined(HOST_BUILD)
+    // The host build models free SRAM, see host/shims/Arduino.h
+#elif defined(__arm__)
     // should use uinstd.h to define sbrk but Due causes a conflict
     extern "C" char* sbrk(int incr);
 #else
@@ -99,3 +99,14 @@ char eeprom_code_read() {
     }
     return '\0';
 }
+
+int eeprom_code_read_chunk(char *buffer, int len) {
+    if (!eeprom_magic_present()) {
+        return 0;
+    }
+    int count = 0;
+    while ((count < len) && (EEPROM_CODE_START + eeprom_code_index < EEPROM_CODE_END)) {
+        buffer[count++] = EEPROM.read(EEPROM_CODE_START + eeprom_code_index++);
+    }
+    return count;
+}
@@ -3,19 +3,22 @@
 #include <Arduino.h>
 #include <EEPROM.h>
 
-#define EEPROM_VERSION "V01"
+#define EEPROM_VERSION "V02"
 
 // Change EEPROM version if these are changed:
 #define EEPROM_OFFSET 100
 
 /**
-* V01 EEPROM Layout:
+* V02 EEPROM Layout:
 *
 *  100  Version                                    (char x4)
 *  104  EEPROM CRC16                               (uint16_t)
 *
-*  106  M2205 S    Unique ID                       (uint8_t)
-*  107  M2206 S    Brightness                      (uint8_t)
+*  106  M2205 S    Unique ID                       (int)
+*       M2617      Global colour correction        (CorrectionSettings)
+*       M2617 Q    For each of MAX_PANELS:
+*                    Has its own colour correction (uint8_t)
+*                    Colour correction             (CorrectionSettings)
 */
 
 #define EEPROM_CODE_START (EEPROM.length() / 2)
@@ -29,5 +32,6 @@ void write_eeprom_code(const char * code, int offset);
 void dump_eeprom_code();
 bool eeprom_code_available();
 char eeprom_code_read();
+int eeprom_code_read_chunk(char *buffer, int len);
 
 #endif /* __EEPROM_H__ */
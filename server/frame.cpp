@@ -0,0 +1,145 @@
+#include "frame.h"
+#include "gcode.h"
+#include "panel.h"
+#include "compress.h"
+#include "serial.h"
+#include "utility.h"
+#include "latency.h"
+
+bool binary_frames_enabled = false;
+
+int cobs_decode(uint8_t *output, const uint8_t *input, int input_len) {
+    int read_index = 0;
+    int write_index = 0;
+    while (read_index < input_len) {
+        uint8_t code = input[read_index++];
+        if (code == 0) {
+            return -1;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            if (read_index >= input_len) {
+                return -1;
+            }
+            output[write_index++] = input[read_index++];
+        }
+        // A maximal run of 0xFF is not followed by an implicit zero
+        if (code != 0xFF && read_index < input_len) {
+            output[write_index++] = 0;
+        }
+    }
+    return write_index;
+}
+
+int process_frame(char *frame) {
+    const char *debug_prefix = "FRM";
+    uint8_t *data = (uint8_t *)frame;
+
+    const uint32_t decode_started = latency_ticks();
+    int frame_len = cobs_decode(data, data, strlen(frame));
+    latency_record(LATENCY_DECODE, decode_started);
+    if (frame_len < FRAME_HEADER_LEN + FRAME_CRC_LEN) {
+        SNPRINTF_MSG_PSTR("Malformed frame, decoded length: %d", frame_len);
+        return 14;
+    }
+
+    int payload_len = data[4] | (data[5] << 8);
+    if (payload_len != frame_len - FRAME_HEADER_LEN - FRAME_CRC_LEN) {
+        SNPRINTF_MSG_PSTR(
+            "Frame payload length %d does not match frame length %d",
+            payload_len, frame_len
+        );
+        return 14;
+    }
+
+    uint16_t checksum = 0;
+    crc16(&checksum, data, frame_len - FRAME_CRC_LEN);
+    uint16_t expected_checksum = data[frame_len - 2] | (data[frame_len - 1] << 8);
+    if (checksum != expected_checksum) {
+        SNPRINTF_MSG_PSTR(
+            "Frame checksum mismatch: Client expected: %d, Server calculated: %d",
+            expected_checksum, checksum
+        );
+        return 19;
+    }
+
+    int codenum = FRAME_CMD_BASE + data[0];
+    int panel_number = data[1];
+    int pixel_offset = data[2] | (data[3] << 8);
+    char *payload = (char *)(data + FRAME_HEADER_LEN);
+
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR(
+            "%s: M%d Q%d S%d, payload_len: %d",
+            debug_prefix, codenum, panel_number, pixel_offset, payload_len
+        );
+    #endif
+
+    switch (codenum) {
+    case 2600:
+    case 2601:
+    case 2602:
+    case 2603:
+    case 2604:
+    case 2607:
+    case 2611:
+        break;
+    case 2610:
+        // The parser holds the last text line, so frames never carry a show time
+        show_panels();
+        return 0;
+    default:
+        SNPRINTF_MSG_PSTR("Unknown frame command: %d", data[0]);
+        return 11;
+    }
+
+    int min_panel_number = 0;
+    int max_panel_number = panel_count - 1;
+    if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+        return 12;
+    }
+
+    if (codenum == 2611) {
+        show_panel(panel_number);
+        return 0;
+    }
+
+    int panel_len = panel_info[panel_number];
+    int min_pixel_offset = 0;
+    int max_pixel_offset = panel_len - 1;
+    if(!validate_int_parameter_bounds('S', pixel_offset, &min_pixel_offset, &max_pixel_offset)){
+        return 13;
+    }
+
+    if (codenum == 2604) {
+        return write_panel_delta(panel_number, pixel_offset, payload, payload_len);
+    }
+    if (codenum == 2607) {
+        return write_panel_compressed(panel_number, pixel_offset, payload, payload_len);
+    }
+
+    if ((payload_len <= 0) || (payload_len % 3) != 0) {
+        SNPRINTF_MSG_PSTR(
+            "frame payload should be a non-zero multiple of 3 bytes: %d",
+            payload_len
+        );
+        return 14;
+    }
+
+    if ((codenum == 2602 || codenum == 2603) && payload_len != 3) {
+        SNPRINTF_MSG_PSTR(
+            "frame payload should be 3 bytes not: %d",
+            payload_len
+        );
+        return 14;
+    }
+
+    if ((payload_len / 3) > (panel_len - pixel_offset)) {
+        SNPRINTF_MSG_PSTR(
+            "frame payload too long for panel. pixels: %d pixel_offset: %d, panel_len: %d",
+            payload_len / 3, pixel_offset, panel_len
+        );
+        return 14;
+    }
+
+    return write_panel_pixels(codenum, panel_number, pixel_offset, payload, payload_len / 3);
+}
@@ -0,0 +1,47 @@
+/**
+ * Binary Frames
+ * An opt-in binary transport for pixel data, enabled with M2620 S1.
+ *
+ * Frames are COBS encoded so that they never contain a zero byte, and are
+ * delimited on the wire by zero bytes, which never appear in GCode text:
+ *
+ *   0x00 <COBS encoded frame> 0x00
+ *
+ * Text GCode continues to work on the same port between frames.
+ *
+ * Decoded frame layout (multi-byte fields are little endian):
+ *
+ *   0  cmd       (uint8_t)   codenum - 2600, e.g. 0 = M2600, 10 = M2610
+ *   1  panel     (uint8_t)   Q parameter
+ *   2  offset    (uint16_t)  S parameter
+ *   4  len       (uint16_t)  length of the payload in bytes
+ *   6  payload   (len bytes) raw pixel bytes, 3 bytes per pixel, delta records for M2604, or compressed for M2607
+ *   6+len crc    (uint16_t)  crc16 of all preceding bytes in the frame
+ */
+
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#include <Arduino.h>
+
+#define FRAME_CMD_BASE 2600
+#define FRAME_HEADER_LEN 6
+#define FRAME_CRC_LEN 2
+
+// Set by M2620, binary frames are only recognised by ingest when enabled
+extern bool binary_frames_enabled;
+
+/**
+ * Decode a COBS encoded buffer. Decoding in place (output == input) is safe.
+ * Returns the decoded length, or -1 if the encoding is malformed.
+ */
+int cobs_decode(uint8_t *output, const uint8_t *input, int input_len);
+
+/**
+ * Decode, validate and execute a queued binary frame.
+ * frame points to the null-terminated COBS encoded bytes.
+ * Return error code
+ */
+int process_frame(char *frame);
+
+#endif /* __FRAME_H__ */
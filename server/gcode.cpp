@@ -1,6 +1,18 @@
 #include "panel.h"
 #include "gcode.h"
 #include "eeprom.h"
+#include "frame.h"
+#include "queue.h"
+#include "palette.h"
+#include "compress.h"
+#include "clock.h"
+#include "jitter.h"
+#include "output.h"
+#include "bench.h"
+#include "capacity.h"
+#include "correction.h"
+#include "latency.h"
+#include "trace.h"
 
 
 // Must be declared for allocation and to satisfy the linker
@@ -13,10 +25,36 @@ int GCodeParser::codenum;
 int GCodeParser::arg_str_len;
 char *GCodeParser::command_args; // start of parameters
 long GCodeParser::linenum;
+uint32_t GCodeParser::codebits;
+uint16_t GCodeParser::param[26];
+uint16_t GCodeParser::param_len[26];
+
+// Class of each character, CHAR_* bits, 7 bit ASCII only
+const uint8_t PROGMEM gcode_char_class[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x10, 0x08, 0x04,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+    0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+    0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
 
 // Create a global instance of the GCode parser singleton
 GCodeParser parser;
 
+// Payload bytes that delta commands did not have to send, compared with M2600
+long delta_bytes_saved = 0;
+
 /**
 * Clear all code-seen (and value pointers)
 *
@@ -26,6 +64,7 @@ GCodeParser parser;
 void GCodeParser::reset()
 {
     arg_str_len = 0;      // No whole line argument
+    codebits = 0;         // No parameters
     command_letter = '?'; // No command letter
     codenum = 0;          // No command code
     linenum = -1;
@@ -36,7 +75,7 @@ void GCodeParser::parse(char *p)
     reset(); // No codes to report
 
     // Skip spaces
-    while (IS_SPACE(*p))
+    while (is_space(*p))
         ++p;
 
     // Skip N[-0-9] if included in the command line
@@ -46,7 +85,7 @@ void GCodeParser::parse(char *p)
         linenum = strtol(p, NULL, 10);
         while (NUMERIC(*p))
             ++p; // skip [0-9]*
-        while (IS_SPACE(*p))
+        while (is_space(*p))
             ++p; // skip [ ]*
     }
 
@@ -56,15 +95,7 @@ void GCodeParser::parse(char *p)
     // Get the command letter
     const char letter = *p++;
 
-    // Nullify asterisk and trailing whitespace
-    char *starpos = strchr(p, CHECKSUM_PREFIX);
-    if (starpos)
-    {
-        --starpos; // *
-        while (IS_SPACE(*starpos))
-            --starpos; // spaces...
-        starpos[1] = '\0';
-    }
+    // The checksum field and the whitespace before it have already been cut off by the CommandReader
 
     // Bail if the letter is not a valid command prefix
     if(!IS_CMD_PREFIX(letter)){
@@ -72,7 +103,7 @@ void GCodeParser::parse(char *p)
     }
 
     // Skip spaces to get the numeric part
-    while (IS_SPACE(*p))
+    while (is_space(*p))
         p++;
 
     // Bail if there's no command code number
@@ -91,31 +122,40 @@ void GCodeParser::parse(char *p)
     } while (NUMERIC(*p));
 
     // Skip all spaces to get to the first argument, or nul
-    while (IS_SPACE(*p))
+    while (is_space(*p))
         p++;
 
-    command_args = p; // Scan for parameters in seen()
+    command_args = p; // Parameters are indexed from here for seen()
 
     while (const char code = *(p++))
     {
-        while (IS_SPACE(*p))
+        while (is_space(*p))
             p++; // Skip spaces between parameters & values
 
-
         #if DEBUG_GCODE
-            const bool has_arg = HAS_ARG(p);
             SER_SNPRINTF_COMMENT_PSTR(
                 "PAR: Got letter %c at index %d ,has_arg: %d",
                 code,
                 (int)(p - command_ptr - 1),
-                has_arg);
+                has_arg(p));
         #endif
 
-        while(HAS_ARG(p))
-            p++;
+        if (has_arg(p))
+        {
+            char *value = p;
+            while (has_arg(p))
+                p++;
+            // The first value of each letter is the one seen
+            if (WITHIN(code, 'A', 'Z') && !(codebits & (1UL << (code - 'A'))))
+            {
+                codebits |= 1UL << (code - 'A');
+                param[code - 'A'] = value - command_args;
+                param_len[code - 'A'] = p - value;
+            }
+        }
 
         //skip all the space until the next argument or null
-        while (IS_SPACE(*p))
+        while (is_space(*p))
             p++;
     }
 }
@@ -187,7 +227,7 @@ void GCodeParser::debug()
 }
 #endif
 
-bool validate_int_parameter_bounds(char parameter, int value, const int *min_value = NULL, const int *max_value = NULL){
+bool validate_int_parameter_bounds(char parameter, int value, const int *min_value, const int *max_value){
     if((min_value != NULL) && (value < *min_value)){
         SNPRINTF_MSG_PSTR(
             "%c Parameter less than minimum %d: %d",
@@ -260,37 +300,26 @@ int gcode_M508() {
             SERIAL_OBJ.println(msg_buffer);
         #endif
 
-        // validate code_payload is base64
-        // TODO: This check might not be necessary if handled in parser
-        // Test with M2600 V/-//
-        char *p = code_payload;
-        int i = 0;
-        while((i < code_payload_len) && (p[i] != '\0')){
-            if(!IS_BASE64(p[i])){
-                SNPRINTF_MSG_PSTR(
-                    "panel payload is not encoded in base64. code_payload: %s offending char: %c, offending index: %d",
-                    code_payload, p, i
-                );
-                return 14;
-            }
-            i++;
-        }
-
-        //TODO: check payload is '\0' terminated?
     }
 
     // Validate code_payload not empty
     // Test with M2600 V
     if(code_payload_len <= 0){
-        SNPRINTF_MSG_PSTR(
-            "panel payload must not be empty",
-            NULL
-        );
+        STRNCPY_MSG_PSTR("panel payload must not be empty");
         return 14;
     }
 
-    char eep_buffer[code_payload_len * 3 / 4];
+    // Room for the terminator write_eeprom_code looks for
+    char eep_buffer[code_payload_len * 3 / 4 + 1];
     int dec_len = base64_decode(eep_buffer, code_payload, code_payload_len);
+    if (dec_len < 0) {
+        SNPRINTF_MSG_PSTR(
+            "code payload is not encoded in base64. offending char: %c, offending index: %d",
+            code_payload[-1 - dec_len], -1 - dec_len
+        );
+        return 14;
+    }
+    eep_buffer[dec_len] = '\0';
     #if DEBUG_GCODE
         STRNCPY_PSTR(
             fmt_buffer, "%c%s: -> decoded payload: (%d) 0x", BUFFLEN_FMT
@@ -331,6 +360,90 @@ int gcode_M509() {
     return 0;
 }
 
+/**
+ * Write decoded pixel data to a panel.
+ * Shared by the M260X text path and binary frames, parameters must already be validated.
+ * pixel_data holds 3 bytes per pixel.
+ */
+int write_panel_pixels(int codenum, int panel_number, int pixel_offset, char *pixel_data, int pixels) {
+    switch (codenum)
+    {
+    case 2600:
+        for (int pixel = 0; pixel < pixels; pixel++)
+        {
+            set_panel_pixel_RGB(panel_number, pixel_offset + pixel, pixel_data + (pixel * 3));
+        }
+        break;
+    case 2601:
+        for (int pixel = 0; pixel < pixels; pixel++)
+        {
+            set_panel_pixel_HSV(panel_number, pixel_offset + pixel, pixel_data + (pixel * 3));
+        }
+        break;
+    case 2602:
+        set_panel_RGB(panel_number, pixel_data, pixel_offset);
+        break;
+    case 2603:
+        set_panel_HSV(panel_number, pixel_data, pixel_offset);
+        break;
+    default:
+        SNPRINTF_MSG_PSTR("Not a pixel command: M%d", codenum);
+        return 11;
+    }
+    return 0;
+}
+
+/**
+ * Apply a delta payload to a panel, starting at pixel_offset.
+ * The payload is a sequence of records: skip (uint8_t) pixels that keep their
+ * value, then count (uint8_t) pixels of RGB data.
+ * All records are checked before any pixel is written.
+ * Return error code
+ */
+int write_panel_delta(int panel_number, int pixel_offset, char *delta, int delta_len) {
+    const int panel_len = panel_info[panel_number];
+    int pixel = pixel_offset;
+    int index = 0;
+    while (index < delta_len) {
+        if (index + 2 > delta_len) {
+            SNPRINTF_MSG_PSTR("delta payload ends in the middle of a record header at byte %d", index);
+            return 14;
+        }
+        const int count = (uint8_t)delta[index + 1];
+        pixel += (uint8_t)delta[index] + count;
+        index += 2 + count * 3;
+        if (index > delta_len) {
+            SNPRINTF_MSG_PSTR(
+                "delta payload ends in the middle of a record, needs %d bytes, has %d",
+                index, delta_len
+            );
+            return 14;
+        }
+        if (pixel > panel_len) {
+            SNPRINTF_MSG_PSTR(
+                "delta payload too long for panel. pixels: %d pixel_offset: %d, panel_len: %d",
+                pixel - pixel_offset, pixel_offset, panel_len
+            );
+            return 14;
+        }
+    }
+    // Writing the same span with M2600 would have taken 3 bytes per pixel
+    delta_bytes_saved += (pixel - pixel_offset) * 3 - delta_len;
+
+    pixel = pixel_offset;
+    index = 0;
+    while (index < delta_len) {
+        pixel += (uint8_t)delta[index];
+        int count = (uint8_t)delta[index + 1];
+        index += 2;
+        for (; count; count--) {
+            set_panel_pixel_RGB(panel_number, pixel++, delta + index);
+            index += 3;
+        }
+    }
+    return 0;
+}
+
 inline bool panel_payload_gcode(){
     return (parser.codenum == 2600 || parser.codenum == 2601);
 }
@@ -405,22 +518,7 @@ int gcode_M260X()
             SERIAL_OBJ.flush();
         #endif
 
-        // validate panel_payload is base64
-        // TODO: This check might not be necessary if handled in parser
-        // Test with M2600 V/-//
-        char *p = panel_payload;
-        int i = 0;
-        while((i < panel_payload_len) && (p[i] != '\0')){
-            if(!IS_BASE64(p[i])){
-                SNPRINTF_MSG_PSTR(
-                    "panel payload is not encoded in base64. panel_payload: %s offending char: %c, offending index: %d",
-                    panel_payload, p, i
-                );
-                return 14;
-            }
-            i++;
-        }
-
+        // panel_payload is validated as base64 while it is decoded
         // validate panel_payload_len is multiple of 4 (4 bytes encoded per 3 pixels (RGB))
         // Test with M2600 V/////
         if((panel_payload_len % 4) != 0){
@@ -455,72 +553,956 @@ int gcode_M260X()
     // Validate panel_payload not empty
     // Test with M2600 V
     if(panel_payload_len <= 0){
+        STRNCPY_MSG_PSTR("panel payload must not be empty");
+        return 14;
+    }
+
+    // Every 4 bytes of encoded base64 corresponds to a single pixel.
+    // RGB pixels are decoded straight into the panel, the rest in place.
+    int result = 0;
+    int dec_len;
+    const uint32_t decode_started = latency_ticks();
+    if (parser.codenum == 2600) {
+        // Checked before decoding into the panel, so that a rejected payload writes nothing
+        dec_len = base64_validate(panel_payload, panel_payload_len);
+        if (dec_len == 0) {
+            dec_len = decode_panel_pixels_RGB(panel_number, pixel_offset, panel_payload, panel_payload_len);
+        }
+    } else {
+        dec_len = base64_decode(panel_payload, panel_payload, panel_payload_len);
+    }
+    latency_record(LATENCY_DECODE, decode_started);
+    // Test with M2600 V/-//
+    if (dec_len < 0) {
         SNPRINTF_MSG_PSTR(
-            "panel payload must not be empty", panel_payload_len
+            "panel payload is not encoded in base64. offending char: %c, offending index: %d",
+            panel_payload[-1 - dec_len], -1 - dec_len
         );
         return 14;
     }
 
-    char pixel_data[3];
-    int dec_len = (panel_payload_len * 3 / 4);
-
     #if DEBUG_GCODE
-        if( panel_payload_gcode() ) {
-            SER_SNPRINTF_COMMENT_PSTR("%s: -> decoded payload: (%d) 0x", debug_prefix, dec_len);
-            for (int pixel = 0; pixel < (panel_payload_len / 4); pixel++)
-            {
-                // every 4 bytes of encoded base64 corresponds to a single RGB pixel
-                base64_decode(pixel_data, panel_payload + (pixel * 4), 4);
-                snprintf(msg_buffer, BUFFLEN_MSG, "%02X%02X%02X", pixel_data[0], pixel_data[1], pixel_data[2]);
-                SERIAL_OBJ.print(msg_buffer);
-            }
-            SERIAL_OBJ.println();
+        SER_SNPRINTF_COMMENT_PSTR("%s: -> decoded payload: (%d) 0x", debug_prefix, dec_len);
+        const char *decoded = (parser.codenum == 2600) ? (const char *)(panels[panel_number] + pixel_offset) : panel_payload;
+        for (int i = 0; i < dec_len; i++)
+        {
+            snprintf(msg_buffer, BUFFLEN_MSG, "%02X", (uint8_t)decoded[i]);
+            SERIAL_OBJ.print(msg_buffer);
         }
+        SERIAL_OBJ.println();
     #endif
 
-    if( panel_payload_gcode() ) {
-        for (int pixel = 0; pixel < (panel_payload_len / 4); pixel++)
-        {
-            // every 4 bytes of encoded base64 corresponds to a single RGB pixel
-            base64_decode(pixel_data, panel_payload + (pixel * 4), 4);
-            if (parser.codenum == 2600)
-            {
-                set_panel_pixel_RGB(panel_number, pixel_offset + pixel, pixel_data);
-            }
-            else if (parser.codenum == 2601)
-            {
-                set_panel_pixel_HSV(panel_number, pixel_offset + pixel, pixel_data);
-            }
-        }
-    } else if (panel_single_gcode()) {
-        base64_decode(pixel_data, panel_payload, 4);
-        if (parser.codenum == 2602)
-        {
-            set_panel_RGB(panel_number, pixel_data, pixel_offset);
-        }
-        else if (parser.codenum == 2603)
-        {
-            set_panel_HSV(panel_number, pixel_data, pixel_offset);
-        }
+    if (parser.codenum != 2600) {
+        result = write_panel_pixels(parser.codenum, panel_number, pixel_offset, panel_payload, dec_len / 3);
     }
 
     #if DEBUG_GCODE
         SER_SNPRINTF_COMMENT_PSTR("%s: done", debug_prefix);
     #endif
 
+    return result;
+}
+
+/**
+ * Streaming M2600 / M2601
+ * The head of the line (up to and including V) has been received and the
+ * payload is decoded into the panel 4 characters at a time as it arrives,
+ * so it never has to fit in the queue. The rest of the validation happens
+ * in stream_M260X_end once the line is complete.
+ */
+static int stream_codenum;
+static int stream_panel;
+static int stream_pixel;
+static bool stream_overflow;
+
+/**
+ * Decode the base64 V parameter in place.
+ * The payload does not need padding.
+ * Return error code
+ */
+int decode_payload_parameter(char **payload, int *payload_len) {
+    if (!parser.seen('V') || (parser.arg_str_len <= 0)) {
+        STRNCPY_MSG_PSTR("panel payload must not be empty");
+        return 14;
+    }
+    char *encoded = parser.value_ptr;
+    const int encoded_len = parser.arg_str_len;
+    // A single leftover char can't encode a byte
+    if ((encoded_len % 4) == 1) {
+        SNPRINTF_MSG_PSTR("base64 panel payload can't be %d chars long", encoded_len);
+        return 14;
+    }
+    const uint32_t decode_started = latency_ticks();
+    const int dec_len = base64_decode(encoded, encoded, encoded_len);
+    latency_record(LATENCY_DECODE, decode_started);
+    if (dec_len < 0) {
+        // The invalid char is after the bytes decoded so far, so it hasn't been overwritten
+        SNPRINTF_MSG_PSTR(
+            "panel payload is not encoded in base64. offending char: %c, offending index: %d",
+            encoded[-1 - dec_len], -1 - dec_len
+        );
+        return 14;
+    }
+    *payload = encoded;
+    *payload_len = dec_len;
+    return 0;
+}
+
+/**
+ * GCode M2604
+ * Set Panel - RGB Delta Payload
+ * Only the pixels that changed are sent, the rest keep the value they had.
+ */
+int gcode_M2604() {
+    const char * debug_prefix = "GCO_M2604";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+
+    int panel_number = parser.intval('Q');
+    int min_panel_number = 0;
+    int max_panel_number = panel_count - 1;
+    if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+        return 12;
+    }
+
+    int pixel_offset = parser.intval('S');
+    int min_pixel_offset = 0;
+    int max_pixel_offset = panel_info[panel_number] - 1;
+    if(!validate_int_parameter_bounds('S', pixel_offset, &min_pixel_offset, &max_pixel_offset)){
+        return 13;
+    }
+
+    char *delta_payload = NULL;
+    int delta_len = 0;
+    int error_code = decode_payload_parameter(&delta_payload, &delta_len);
+    if (error_code) {
+        return error_code;
+    }
+
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR(
+            "%s: -> panel_number: %d, pixel_offset: %d, delta_len: %d",
+            debug_prefix, panel_number, pixel_offset, delta_len
+        );
+    #endif
+
+    return write_panel_delta(panel_number, pixel_offset, delta_payload, delta_len);
+}
+
+/**
+ * GCode M2605
+ * Set Palette - RGB Payload
+ * Sets the palette of panel Q, or the global palette if Q is not given.
+ */
+int gcode_M2605() {
+    const char * debug_prefix = "GCO_M2605";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+
+    int panel_number = GLOBAL_PALETTE;
+    if (parser.seen('Q')) {
+        panel_number = parser.value_int();
+        int min_panel_number = 0;
+        int max_panel_number = panel_count - 1;
+        if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+            return 12;
+        }
+    }
+
+    int entry_offset = parser.intval('S');
+    int min_entry_offset = 0;
+    int max_entry_offset = PALETTE_SIZE - 1;
+    if(!validate_int_parameter_bounds('S', entry_offset, &min_entry_offset, &max_entry_offset)){
+        return 13;
+    }
+
+    char *palette_payload = NULL;
+    int palette_payload_len = 0;
+    int error_code = decode_payload_parameter(&palette_payload, &palette_payload_len);
+    if (error_code) {
+        return error_code;
+    }
+    if ((palette_payload_len % 3) != 0) {
+        SNPRINTF_MSG_PSTR(
+            "palette payload should be a multiple of 3 bytes: %d", palette_payload_len
+        );
+        return 14;
+    }
+    int entries = palette_payload_len / 3;
+    if (entry_offset + entries > PALETTE_SIZE) {
+        SNPRINTF_MSG_PSTR(
+            "palette payload too long. entries: %d, entry_offset: %d, palette_size: %d",
+            entries, entry_offset, PALETTE_SIZE
+        );
+        return 14;
+    }
+
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR(
+            "%s: -> panel_number: %d, entry_offset: %d, entries: %d",
+            debug_prefix, panel_number, entry_offset, entries
+        );
+    #endif
+
+    return set_palette_entries(panel_number, entry_offset, palette_payload, entries);
+}
+
+/**
+ * GCode M2606
+ * Set Panel - Indexed Payload
+ * B is the bits per index, 1, 2, 4 or 8.
+ */
+int gcode_M2606() {
+    const char * debug_prefix = "GCO_M2606";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+
+    int panel_number = parser.intval('Q');
+    int min_panel_number = 0;
+    int max_panel_number = panel_count - 1;
+    if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+        return 12;
+    }
+
+    const int panel_len = panel_info[panel_number];
+    int pixel_offset = parser.intval('S');
+    int min_pixel_offset = 0;
+    int max_pixel_offset = panel_len - 1;
+    if(!validate_int_parameter_bounds('S', pixel_offset, &min_pixel_offset, &max_pixel_offset)){
+        return 13;
+    }
+
+    int bits = parser.intval('B', 8);
+    if (bits != 1 && bits != 2 && bits != 4 && bits != 8) {
+        SNPRINTF_MSG_PSTR("bits per index should be 1, 2, 4 or 8: %d", bits);
+        return 14;
+    }
+
+    char *index_payload = NULL;
+    int index_payload_len = 0;
+    int error_code = decode_payload_parameter(&index_payload, &index_payload_len);
+    if (error_code) {
+        return error_code;
+    }
+    int pixels = index_payload_len * 8 / bits;
+    // Indices padding the last byte out past the end of the panel are ignored
+    if (pixels > panel_len - pixel_offset && pixels - (panel_len - pixel_offset) < 8 / bits) {
+        pixels = panel_len - pixel_offset;
+    }
+    if (pixels > panel_len - pixel_offset) {
+        SNPRINTF_MSG_PSTR(
+            "index payload too long for panel. pixels: %d pixel_offset: %d, panel_len: %d",
+            pixels, pixel_offset, panel_len
+        );
+        return 14;
+    }
+
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR(
+            "%s: -> panel_number: %d, pixel_offset: %d, bits: %d, pixels: %d",
+            debug_prefix, panel_number, pixel_offset, bits, pixels
+        );
+    #endif
+
+    return write_panel_indexed(panel_number, pixel_offset, bits, index_payload, pixels);
+}
+
+/**
+ * GCode M2607
+ * Set Panel - RGB Compressed Payload
+ * See compress.h for the payload format.
+ */
+int gcode_M2607() {
+    const char * debug_prefix = "GCO_M2607";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+
+    int panel_number = parser.intval('Q');
+    int min_panel_number = 0;
+    int max_panel_number = panel_count - 1;
+    if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+        return 12;
+    }
+
+    int pixel_offset = parser.intval('S');
+    int min_pixel_offset = 0;
+    int max_pixel_offset = panel_info[panel_number] - 1;
+    if(!validate_int_parameter_bounds('S', pixel_offset, &min_pixel_offset, &max_pixel_offset)){
+        return 13;
+    }
+
+    char *compressed_payload = NULL;
+    int compressed_len = 0;
+    int error_code = decode_payload_parameter(&compressed_payload, &compressed_len);
+    if (error_code) {
+        return error_code;
+    }
+
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR(
+            "%s: -> panel_number: %d, pixel_offset: %d, compressed_len: %d",
+            debug_prefix, panel_number, pixel_offset, compressed_len
+        );
+    #endif
+
+    return write_panel_compressed(panel_number, pixel_offset, compressed_payload, compressed_len);
+}
+
+/**
+ * GCode P2607
+ * Benchmark the compressed payload decoder
+ * Decodes the payload into the panel I times without showing it, and responds
+ * with the pixels decoded, the payload and raw sizes in bytes, and the total time in us.
+ */
+int gcode_P2607() {
+    int panel_number = parser.intval('Q');
+    int min_panel_number = 0;
+    int max_panel_number = panel_count - 1;
+    if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+        return 12;
+    }
+
+    int pixel_offset = parser.intval('S');
+    int min_pixel_offset = 0;
+    int max_pixel_offset = panel_info[panel_number] - 1;
+    if(!validate_int_parameter_bounds('S', pixel_offset, &min_pixel_offset, &max_pixel_offset)){
+        return 13;
+    }
+
+    int iterations = max(1, parser.intval('I', 100));
+
+    char *compressed_payload = NULL;
+    int compressed_len = 0;
+    int error_code = decode_payload_parameter(&compressed_payload, &compressed_len);
+    if (error_code) {
+        return error_code;
+    }
+    int pixels = compressed_pixels(compressed_payload, compressed_len, panel_info[panel_number] - pixel_offset);
+    if (pixels < 0) {
+        return 14;
+    }
+
+    stopwatch_start_0();
+    for (int i = 0; i < iterations; i++) {
+        write_panel_compressed(panel_number, pixel_offset, compressed_payload, compressed_len);
+    }
+    long elapsed = stopwatch_stop_0();
+
+    SNPRINTF_MSG_PSTR(
+        "P%d B%d R%d T%ld", pixels * iterations, compressed_len * iterations, pixels * 3 * iterations, elapsed
+    );
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * Return true if head is a streamable command with valid Q and S parameters
+ */
+bool stream_M260X_begin(char *head) {
+    parser.parse(head);
+    if (parser.command_letter != 'M' || !panel_payload_gcode()) {
+        return false;
+    }
+    // Lines without them are queued and validated by gcode_M260X like any other
+    if (!parser.seen('Q') || !parser.seen('S')) {
+        return false;
+    }
+    int panel_number = parser.intval('Q');
+    if (!WITHIN(panel_number, 0, panel_count - 1)) {
+        return false;
+    }
+    int pixel_offset = parser.intval('S');
+    if (!WITHIN(pixel_offset, 0, panel_info[panel_number] - 1)) {
+        return false;
+    }
+    stream_codenum = parser.codenum;
+    stream_panel = panel_number;
+    stream_pixel = pixel_offset;
+    stream_overflow = false;
+    return true;
+}
+
+/**
+ * Decode pixels (4 base64 characters each) into the panel
+ */
+void stream_M260X_pixels(const char *payload, int pixels) {
+    const int room = panel_info[stream_panel] - stream_pixel;
+    if (pixels > room) {
+        stream_overflow = true;
+        pixels = room;
+    }
+    // The reader only streams base64 characters, so these can't fail
+    const uint32_t decode_started = latency_ticks();
+    if (stream_codenum == 2600) {
+        decode_panel_pixels_RGB(stream_panel, stream_pixel, payload, pixels * 4);
+        stream_pixel += pixels;
+    } else {
+        char pixel_data[3];
+        for (int pixel = 0; pixel < pixels; pixel++) {
+            base64_decode(pixel_data, payload + (pixel * 4), 4);
+            set_panel_pixel_HSV(stream_panel, stream_pixel, pixel_data);
+            stream_pixel++;
+        }
+    }
+    latency_record(LATENCY_DECODE, decode_started);
+}
+
+int stream_M260X_codenum() {
+    return stream_codenum;
+}
+
+/**
+ * Validate the streamed payload once the line is complete
+ * Return error code
+ */
+int stream_M260X_end(int payload_len, bool bad_tail) {
+    if (bad_tail) {
+        SNPRINTF_MSG_PSTR("panel payload is not encoded in base64. payload_len: %d", payload_len);
+        return 14;
+    }
+    if (payload_len <= 0) {
+        STRNCPY_MSG_PSTR("panel payload must not be empty");
+        return 14;
+    }
+    if ((payload_len % 4) != 0) {
+        SNPRINTF_MSG_PSTR(
+            "base64 panel payload should be a multiple of 4 bytes. payload_len: %d",
+            payload_len
+        );
+        return 14;
+    }
+    if (stream_overflow) {
+        SNPRINTF_MSG_PSTR(
+            "base64 panel payload too long for panel. panel_payload_len (encoded bytes): %d, panel_len: %d",
+            payload_len, panel_info[stream_panel]
+        );
+        return 14;
+    }
     return 0;
 }
 
+/**
+ * GCode M2610
+ * Show the panels, or at time T on the synced clock in ms if given.
+ */
 int gcode_M2610() {
     const char * debug_prefix = "GCO";
     #if DEBUG_GCODE
         SER_SNPRINTF_COMMENT_PSTR("%s: Calling M2610", debug_prefix);
     #endif
-    FastLED.show();
+    if (parser.seen('T')) {
+        jitter_schedule(parser.value_ulong());
+        return 0;
+    }
+    show_panels();
+    return 0;
+}
+
+/**
+ * GCode P2610
+ * Responds with the synced clock in ms, the number of timed frames waiting,
+ * and the number of timed frames shown late and early.
+ */
+int gcode_P2610() {
+    SNPRINTF_MSG_PSTR(
+        "T%lu F%d L%ld E%ld", clock_millis(), jitter_count, frames_late, frames_early
+    );
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
     return 0;
 }
 
+/**
+ * GCode M2611
+ * Show panel Q, or only the panels that changed since they were last shown if Q is not given.
+ */
 int gcode_M2611() {
-    // TODO: Is this even possible?
+    const char * debug_prefix = "GCO_M2611";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+    if (!parser.seen('Q')) {
+        show_changed_panels();
+        return 0;
+    }
+    int panel_number = parser.value_int();
+    int min_panel_number = 0;
+    int max_panel_number = panel_count - 1;
+    if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+        return 12;
+    }
+    show_panel(panel_number);
+    return 0;
+}
+
+/**
+ * GCode M2612
+ * Begin Frame
+ * Pixels written until the frame is committed are not shown, shows keep displaying the last frame.
+ */
+int gcode_M2612() {
+    const char * debug_prefix = "GCO_M2612";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+    frame_open = true;
+    return 0;
+}
+
+/**
+ * GCode M2613
+ * Commit Frame
+ * Copies the pixels written since the frame began to the LEDs and shows them,
+ * or at time T on the synced clock in ms if given.
+ */
+int gcode_M2613() {
+    const char * debug_prefix = "GCO_M2613";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+    frame_open = false;
+    if (parser.seen('T')) {
+        jitter_schedule(parser.value_ulong());
+        return 0;
+    }
+    show_panels();
+    return 0;
+}
+
+/**
+ * GCode P2615
+ * Clock ping, responds with the low 32 bits of local_micros() when the command
+ * started (R) and just before the response (X), and of the synced clock when
+ * it started (C), for the host to work out the round trip time and the offset
+ * of the synced clock.
+ */
+int gcode_P2615() {
+    unsigned long received = (unsigned long)local_micros();
+    unsigned long synced = (unsigned long)clock_micros();
+    SNPRINTF_MSG_PSTR(
+        "C%lu D%ld Y%d R%lu X", synced, clock_drift_ppb, clock_synced, received
+    );
+    // The transmit time goes last, so it is taken as late as possible
+    int msg_len = strlen(msg_buffer);
+    snprintf(msg_buffer + msg_len, BUFFLEN_MSG - msg_len, "%lu", (unsigned long)local_micros());
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode M2615
+ * Set the synced clock so that it read T ms and U us at local time S,
+ * the low 32 bits of local_micros() from a P2615 response.
+ * Responds with the drift estimate.
+ */
+int gcode_M2615() {
+    const char * debug_prefix = "GCO_M2615";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+    if (!parser.seen('S') || !parser.seen('T')) {
+        STRNCPY_MSG_PSTR("M2615 needs S and T");
+        return 13;
+    }
+    uint64_t local_us = local_micros_from(parser.ulongval('S'));
+    uint64_t host_us = (uint64_t)parser.ulongval('T') * 1000 + parser.ulongval('U');
+    clock_sync(local_us, host_us);
+    SNPRINTF_MSG_PSTR("D%ld", clock_drift_ppb);
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode M2616
+ * Select the output backend S (0 = FastLED, 1 = null, 2 = recording), responds with the backend.
+ * Selecting the recording backend again clears its records.
+ */
+int gcode_M2616() {
+    const char * debug_prefix = "GCO_M2616";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+    if (parser.seen('S')) {
+        int backend = parser.value_int();
+        int min_backend = OUTPUT_FASTLED;
+        int max_backend = OUTPUT_RECORDING;
+        if(!validate_int_parameter_bounds('S', backend, &min_backend, &max_backend)){
+            return 13;
+        }
+        finish_output();
+        int error_code = set_output_backend(backend);
+        if (error_code) {
+            return error_code;
+        }
+    }
+    SNPRINTF_MSG_PSTR("S%d %s", output_backend_index, output_backend->name);
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode M2617
+ * Set Colour Correction
+ * Sets the colour correction of panel Q, or the global colour correction if Q is not given,
+ * which panels with their own colour correction also go back to. Parameters that are not
+ * given keep their current values. Responds with the new settings. M500 stores them.
+ */
+int gcode_M2617() {
+    const char * debug_prefix = "GCO_M2617";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+
+    int panel_number = GLOBAL_CORRECTION;
+    if (parser.seen('Q')) {
+        panel_number = parser.value_int();
+        int min_panel_number = 0;
+        int max_panel_number = panel_count - 1;
+        if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+            return 12;
+        }
+    }
+    CorrectionSettings correction = (panel_number == GLOBAL_CORRECTION)
+        ? global_correction : panel_corrections[panel_number];
+
+    if (parser.seen('E')) {
+        int gamma = parser.value_int();
+        int min_gamma = 0;
+        int max_gamma = 1000;
+        if(!validate_int_parameter_bounds('E', gamma, &min_gamma, &max_gamma)){
+            return 13;
+        }
+        correction.gamma = gamma;
+    }
+    const char letters[] = {'S', 'R', 'G', 'B'};
+    uint8_t *fields[] = {&correction.brightness, &correction.white[0], &correction.white[1], &correction.white[2]};
+    for (int i = 0; i < 4; i++) {
+        if (parser.seen(letters[i])) {
+            int value = parser.value_int();
+            int min_value = 0;
+            int max_value = 255;
+            if(!validate_int_parameter_bounds(letters[i], value, &min_value, &max_value)){
+                return 13;
+            }
+            *fields[i] = value;
+        }
+    }
+
+    int error_code = set_correction(panel_number, &correction);
+    if (error_code) {
+        return error_code;
+    }
+    SNPRINTF_MSG_PSTR(
+        "E%d S%d R%d G%d B%d",
+        correction.gamma, correction.brightness, correction.white[0], correction.white[1], correction.white[2]
+    );
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode M2618
+ * Set Colour Correction - Table Payload
+ * Sets entries of the colour correction table of panel Q, or the global table if Q is not given.
+ */
+int gcode_M2618() {
+    const char * debug_prefix = "GCO_M2618";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+
+    int panel_number = GLOBAL_CORRECTION;
+    if (parser.seen('Q')) {
+        panel_number = parser.value_int();
+        int min_panel_number = 0;
+        int max_panel_number = panel_count - 1;
+        if(!validate_int_parameter_bounds('Q', panel_number, &min_panel_number, &max_panel_number)){
+            return 12;
+        }
+    }
+
+    int entry_offset = parser.intval('S');
+    int min_entry_offset = 0;
+    int max_entry_offset = CORRECTION_ENTRIES - 1;
+    if(!validate_int_parameter_bounds('S', entry_offset, &min_entry_offset, &max_entry_offset)){
+        return 13;
+    }
+
+    char *table_payload = NULL;
+    int table_payload_len = 0;
+    int error_code = decode_payload_parameter(&table_payload, &table_payload_len);
+    if (error_code) {
+        return error_code;
+    }
+    if (entry_offset + table_payload_len > CORRECTION_ENTRIES) {
+        SNPRINTF_MSG_PSTR(
+            "correction payload too long. entries: %d, entry_offset: %d, table_size: %d",
+            table_payload_len, entry_offset, CORRECTION_ENTRIES
+        );
+        return 14;
+    }
+
+    return set_correction_entries(panel_number, entry_offset, table_payload, table_payload_len);
+}
+
+/**
+ * GCode P2616
+ * Dump the recording backend's records, oldest first, one per line as
+ * "T<micros> Q<panel> C<crc16 of the panel's pixels>", then the number of panels recorded.
+ */
+int gcode_P2616() {
+    const OutputRecord *record;
+    for (int n = 0; (record = output_record(n)); n++) {
+        SNPRINTF_MSG_PSTR("T%lu Q%d C%u", record->time, record->panel, record->checksum);
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    SNPRINTF_MSG_PSTR("R%ld", output_recorded);
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode P2617
+ * Estimate the frame rate when every pixel is sent each frame, see capacity.h
+ * Responds with the bytes per frame, the link, decode, LED clock out and frame times in us,
+ * the frame rate, and the bottleneck.
+ */
+int gcode_P2617() {
+    int encoding = parser.intval('E', ENCODING_TEXT);
+    int min_encoding = ENCODING_TEXT;
+    int max_encoding = ENCODING_BINARY;
+    if(!validate_int_parameter_bounds('E', encoding, &min_encoding, &max_encoding)){
+        return 13;
+    }
+    long baud = parser.longval('B', SERIAL_BAUD);
+    if (baud < 0) {
+        baud = 0;
+    }
+
+    const long decode_ns = measure_decode_ns(encoding);
+    if (decode_ns < 0) {
+        return 2;
+    }
+    CapacityEstimate estimate;
+    estimate_capacity(&estimate, encoding, baud, decode_ns);
+    unsigned long fps_centi = estimate.frame_us ? 100000000UL / estimate.frame_us : 0;
+
+    SNPRINTF_MSG_PSTR(
+        "Y%ld L%lu D%lu C%lu T%lu F%lu.%02lu X%s",
+        estimate.frame_bytes, estimate.link_us, estimate.decode_us, estimate.clock_out_us,
+        estimate.frame_us, fps_centi / 100, fps_centi % 100, estimate.bottleneck
+    );
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+int kernel_bench_results;
+
+/**
+ * Report one kernel benchmark result as a line, for P2619
+ */
+void report_kernel_bench(const char *kernel, int bytes, int pixels, long iterations, unsigned long elapsed) {
+    SNPRINTF_MSG_PSTR("K%s B%d P%d I%ld T%lu", kernel, bytes, pixels, iterations, elapsed);
+    SERIAL_OBJ.println(msg_buffer);
+    kernel_bench_results++;
+}
+
+/**
+ * GCode P2619
+ * Benchmark the hot path kernels, see bench.h
+ * Each kernel is run at each payload size for max(1, B / size) iterations. Responds with a line per
+ * kernel and size as "K<kernel> B<bytes> P<pixels> I<iterations> T<us>", then the number of lines.
+ */
+int gcode_P2619() {
+    long budget = parser.longval('B', 4096);
+    if (budget < 1) {
+        budget = 1;
+    }
+    kernel_bench_results = 0;
+    int error_code = bench_kernels(report_kernel_bench, budget);
+    if (error_code) {
+        return error_code;
+    }
+    SNPRINTF_MSG_PSTR("R%d", kernel_bench_results);
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode M2620
+ * Enable (S1) or disable (S0) binary frames, responds with the new state.
+ * Hosts should wait for the response before sending frames.
+ */
+int gcode_M2620() {
+    const char * debug_prefix = "GCO_M2620";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+    if (parser.seen('S')) {
+        binary_frames_enabled = parser.value_bool();
+    }
+    SNPRINTF_MSG_PSTR("S%d", binary_frames_enabled);
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode M2621
+ * Enable (S1) or disable (S0) flow control, responds with the new state and the free queue capacity.
+ * While enabled, every numbered line is acked with "OK C<free slots> B<free bytes>",
+ * and IDLE lines carry the same fields.
+ */
+int gcode_M2621() {
+    const char * debug_prefix = "GCO_M2621";
+    #if DEBUG_GCODE
+        SER_SNPRINTF_COMMENT_PSTR("%s: Calling M%d", debug_prefix, parser.codenum);
+    #endif
+    if (parser.seen('S')) {
+        flow_control_enabled = parser.value_bool();
+    }
+    SNPRINTF_MSG_PSTR(
+        "S%d C%d B%d", flow_control_enabled, queue_free_slots(), queue_free_bytes()
+    );
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode P2622
+ * Dump the latency histograms, see latency.h. Responds with a line per stage as
+ * "K<stage> N<count> X<max ticks> B<first bucket> H<count>,<count>,...", from the first
+ * bucket with a count to the last, then the ticks per second.
+ */
+int gcode_P2622() {
+    for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+        #if LATENCY_HISTOGRAMS
+            const LatencyHistogram *histogram = &latency_histograms[stage];
+            SNPRINTF_MSG_PSTR(
+                "K%s N%lu X%lu", latency_stage_names[stage], histogram->count, histogram->max
+            );
+            if (histogram->count) {
+                int first = 0;
+                int last = LATENCY_BUCKETS - 1;
+                while (!histogram->buckets[first]) {
+                    first++;
+                }
+                while (!histogram->buckets[last]) {
+                    last--;
+                }
+                int len = strlen(msg_buffer);
+                len += snprintf(msg_buffer + len, BUFFLEN_MSG - len, " B%d H", first);
+                for (int bucket = first; (bucket <= last) && (len < BUFFLEN_MSG); bucket++) {
+                    len += snprintf(
+                        msg_buffer + len, BUFFLEN_MSG - len, (bucket > first) ? ",%lu" : "%lu",
+                        histogram->buckets[bucket]
+                    );
+                }
+            }
+        #else
+            // Nothing is recorded, every histogram is empty
+            SNPRINTF_MSG_PSTR("K%s N0 X0", latency_stage_names[stage]);
+        #endif
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    SNPRINTF_MSG_PSTR("U%lu", latency_ticks_per_second);
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
+    return 0;
+}
+
+/**
+ * GCode M2622
+ * Reset the latency histograms
+ */
+int gcode_M2622() {
+    reset_latency();
+    return 0;
+}
+
+// Trace events per line of a P2623 dump, 172 base64 characters
+#define TRACE_DUMP_LINE_EVENTS 16
+
+/**
+ * GCode P2623
+ * Dump the trace ring, see trace.h, oldest event first. Responds with lines of
+ * "V<base64 events>", TRACE_EVENT_SIZE bytes each, then
+ * "D<events dumped> R<events recorded> U<ticks per second>".
+ * C1 also clears the ring.
+ */
+int gcode_P2623() {
+    uint8_t packed[TRACE_DUMP_LINE_EVENTS * TRACE_EVENT_SIZE];
+    int dumped = 0;
+    const TraceEvent *event = trace_get(0);
+    while (event) {
+        int count = 0;
+        while (event && (count < TRACE_DUMP_LINE_EVENTS)) {
+            trace_pack(packed + count * TRACE_EVENT_SIZE, event);
+            count++;
+            event = trace_get(dumped + count);
+        }
+        msg_buffer[0] = 'V';
+        base64_encode(msg_buffer + 1, (char *)packed, count * TRACE_EVENT_SIZE);
+        SERIAL_OBJ.println(msg_buffer);
+        dumped += count;
+    }
+    SNPRINTF_MSG_PSTR("D%d R%lu U%lu", dumped, trace_recorded, latency_ticks_per_second);
+    if (parser.boolval('C')) {
+        trace_clear();
+    }
+    if(parser.linenum >= 0){
+        print_line_response(parser.linenum, msg_buffer);
+    } else {
+        SERIAL_OBJ.println(msg_buffer);
+    }
     return 0;
 }
@@ -8,13 +8,22 @@
 #include "serial.h"
 #include "macros.h"
 
+// Character classes, see gcode_char_class
+#define CHAR_SPACE  0x01    // Whitespace, including line endings
+#define CHAR_DIGIT  0x02    // 0-9
+#define CHAR_BASE64 0x04    // Base 64 digits, including 0-9
+#define CHAR_POINT  0x08    // Decimal point
+#define CHAR_SIGN   0x10    // + or -
+
+extern const uint8_t gcode_char_class[256];
+
 /**
  * GCode parser
  *
  *  - Parse a single gcode line for its letter, code, subcode, and parameters
- *  - FASTER_GCODE_PARSER:
- *    - Flags existing params (1 bit each)
- *    - Stores value offsets (1 byte each)
+ *  - Index the parameters in the same pass:
+ *    - Flags each letter seen with a value (1 bit each)
+ *    - Stores the offset and length of its value (2 bytes each)
  *  - Provide accessors for parameters:
  *    - Parameter exists
  *    - Parameter has value
@@ -23,7 +32,33 @@
 class GCodeParser
 {
   private:
-    static char *command_args; // Start of arguments after command code
+    static char *command_args;      // Start of arguments after command code
+    static uint32_t codebits;       // One bit per letter A-Z seen with a value
+    static uint16_t param[26];      // Offset of each letter's value from command_args
+    static uint16_t param_len[26];  // Length of each letter's value
+
+    FORCE_INLINE static uint8_t char_class(const char c)
+    {
+        return pgm_read_byte(&gcode_char_class[(uint8_t)c]);
+    }
+
+    FORCE_INLINE static bool is_space(const char c)
+    {
+        return char_class(c) & CHAR_SPACE;
+    }
+
+    // Same as HAS_ARG: a base 64 digit, or a number starting with a sign or decimal point
+    FORCE_INLINE static bool has_arg(const char *p)
+    {
+        uint8_t c = char_class(p[0]);
+        if (c & CHAR_BASE64)
+            return true;
+        if (c & CHAR_SIGN)
+            c = char_class(*++p);
+        if (c & CHAR_DIGIT)
+            return true;
+        return (c & CHAR_POINT) && (char_class(p[1]) & CHAR_DIGIT);
+    }
 
   public:
     static char *command_ptr;       // Start of the actual command, so it can be echoed
@@ -40,36 +75,19 @@ class GCodeParser
     // Reset is done before parsing
     static void reset();
 
-    // Code is found in the string. If not found, value_ptr is unchanged.
-    // This allows "if (seen('A')||seen('B'))" to use the last-found value.
-    // Scans command_args for the argument `c`, and sets `value_ptr` and `arg_str_len` if found.
+    // Code is found in the string. If not found, value_ptr is NULL.
+    // Looks up the argument `c` in the index built by parse(), and sets `value_ptr` and `arg_str_len` if found.
+    // Only the first value of a letter is seen, and a letter without a value is not seen.
 
     static bool seen(const char c)
     {
-        char *p = command_args;
         value_ptr = NULL;
         arg_str_len = 0;
-        while( const char code = *p++ ){
-            while (IS_SPACE(*p)){
-                p++; // Skip spaces between parameters & values
-            }
-            if ((code == c) && (HAS_ARG(p))){
-                value_ptr = p;
-            }
-            while (HAS_ARG(p)){
-                p++; // Skip to the end of the
-            }
-            if ((code == c) && (!!value_ptr))
-            {
-                arg_str_len = (p - value_ptr);
-                return true;
-            }
-            while (IS_SPACE(*p))
-            {
-                p++; // Skip spaces until next parameter
-            }
-        }
-        return false;
+        if (!WITHIN(c, 'A', 'Z') || !(codebits & (1UL << (c - 'A'))))
+            return false;
+        value_ptr = command_args + param[c - 'A'];
+        arg_str_len = param_len[c - 'A'];
+        return true;
     }
 
     static bool seen_any()
@@ -195,11 +213,52 @@ class GCodeParser
 
 extern GCodeParser parser;
 
+bool validate_int_parameter_bounds(char parameter, int value, const int *min_value = NULL, const int *max_value = NULL);
+int write_panel_pixels(int codenum, int panel_number, int pixel_offset, char *pixel_data, int pixels);
+int write_panel_delta(int panel_number, int pixel_offset, char *delta, int delta_len);
+
+// Payload bytes that delta commands did not have to send, compared with M2600
+extern long delta_bytes_saved;
+
+/**
+ * Streaming M2600 / M2601
+ * Used by CommandReader to decode a payload into the panel while the line is still arriving
+ */
+bool stream_M260X_begin(char *head);
+void stream_M260X_pixels(const char *payload, int pixels);
+int stream_M260X_end(int payload_len, bool bad_tail);
+
+/**
+ * Code number of the command being streamed, or last streamed
+ */
+int stream_M260X_codenum();
+
 int gcode_M508();
 int gcode_M509();
 int gcode_M260X();
+int gcode_M2604();
+int gcode_M2605();
+int gcode_M2606();
+int gcode_M2607();
+int gcode_P2607();
 int gcode_M2610();
+int gcode_P2610();
 int gcode_M2611();
+int gcode_M2612();
+int gcode_M2613();
+int gcode_P2615();
+int gcode_M2615();
+int gcode_M2616();
+int gcode_M2617();
+int gcode_M2618();
+int gcode_P2616();
+int gcode_P2617();
+int gcode_P2619();
+int gcode_M2620();
+int gcode_M2621();
+int gcode_P2622();
+int gcode_M2622();
+int gcode_P2623();
 
 
 #endif /* __GCODE_H__ */
@@ -0,0 +1,110 @@
+#include "jitter.h"
+#include "panel.h"
+#include "clock.h"
+#include "output.h"
+#include "correction.h"
+#include "serial.h"
+#include "debug.h"
+#include "macros.h"
+
+long frames_late = 0;
+long frames_early = 0;
+
+CRGB *jitter_frames = NULL;     // JITTER_BUFFER_FRAMES snapshots of pixel_count pixels
+unsigned long jitter_times[MAX(1, JITTER_BUFFER_FRAMES)];  // At least one so the code builds without the buffer
+int jitter_slots = 0;           // Number of snapshots allocated
+int jitter_head = 0;            // Oldest frame waiting
+int jitter_count = 0;           // Number of frames waiting
+
+int init_jitter() {
+    #if JITTER_BUFFER_FRAMES
+        if (!jitter_frames && double_buffered) {
+            const int frame_size = pixel_count * sizeof(CRGB);
+            if (getFreeSram() - QUEUE_SRAM_RESERVE - QUEUE_MIN_SIZE < JITTER_BUFFER_FRAMES * frame_size) {
+                return 0;
+            }
+            jitter_frames = (CRGB *)malloc(JITTER_BUFFER_FRAMES * frame_size);
+            if (!jitter_frames) {
+                SNPRINTF_MSG_PSTR("malloc failed for jitter buffer: %d bytes", JITTER_BUFFER_FRAMES * frame_size);
+                return 2;
+            }
+            jitter_slots = JITTER_BUFFER_FRAMES;
+        }
+    #endif
+    jitter_clear();
+    return 0;
+}
+
+void jitter_clear() {
+    jitter_head = 0;
+    jitter_count = 0;
+}
+
+bool jitter_pending() {
+    return jitter_count > 0;
+}
+
+/**
+ * Count a frame shown at now that was meant to be shown at show_time
+ */
+inline void count_frame_timing(unsigned long show_time, unsigned long now) {
+    if ((long)(show_time - now) > 0) {
+        frames_early++;
+    } else if ((long)(now - show_time) > JITTER_LATE_MARGIN) {
+        frames_late++;
+    }
+}
+
+/**
+ * Show the oldest frame waiting
+ */
+void jitter_show_head() {
+    finish_output();
+    CRGB *frame = jitter_frames + (jitter_head * pixel_count);
+    for (int panel = 0; panel < panel_count; panel++) {
+        correct_pixels(panel, shown_panels[panel], frame, panel_info[panel]);
+        frame += panel_info[panel];
+    }
+    count_frame_timing(jitter_times[jitter_head], clock_millis());
+    jitter_head = (jitter_head + 1) % jitter_slots;
+    jitter_count--;
+    output_show((1U << panel_count) - 1);
+    FastLED.countFPS();
+    panels_changed = 0;
+}
+
+void jitter_schedule(unsigned long show_time) {
+    if (!jitter_slots) {
+        count_frame_timing(show_time, clock_millis());
+        show_panels();
+        return;
+    }
+    if (jitter_count == jitter_slots) {
+        jitter_show_head();
+    }
+    const int slot = (jitter_head + jitter_count) % jitter_slots;
+    CRGB *frame = jitter_frames + (slot * pixel_count);
+    for (int panel = 0; panel < panel_count; panel++) {
+        memcpy(frame, panels[panel], panel_info[panel] * sizeof(CRGB));
+        frame += panel_info[panel];
+    }
+    jitter_times[slot] = show_time;
+    jitter_count++;
+}
+
+void jitter_service() {
+    if (!jitter_count || (long)(clock_millis() - jitter_times[jitter_head]) < 0) {
+        return;
+    }
+    // Frames that are already overdue behind the next one are dropped rather than shown back to back
+    while (jitter_count > 1) {
+        const int next = (jitter_head + 1) % jitter_slots;
+        if ((long)(clock_millis() - jitter_times[next]) < 0) {
+            break;
+        }
+        frames_late++;
+        jitter_head = next;
+        jitter_count--;
+    }
+    jitter_show_head();
+}
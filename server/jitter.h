@@ -0,0 +1,56 @@
+/**
+ * Jitter Buffer
+ * Holds frames that are to be shown at a given time on the synced clock
+ * (clock_millis()), so frames are shown evenly paced however unevenly
+ * they arrive.
+ *
+ * A timed show takes a snapshot of the back buffers, and loop() shows the
+ * oldest snapshot once its time comes. Frames are shown in the order they
+ * arrive. If the buffer is full, the oldest frame is shown early to make room.
+ *
+ * This needs the panels to be double buffered. Without the buffer, a timed
+ * show happens straight away and is counted as early or late.
+ */
+
+#ifndef __JITTER_H__
+#define __JITTER_H__
+
+#include <Arduino.h>
+#include "config.h"
+
+// Frames shown more than JITTER_LATE_MARGIN ms after their time
+extern long frames_late;
+// Number of frames waiting to be shown
+extern int jitter_count;
+// Frames shown before their time, because the buffer was full
+extern long frames_early;
+
+/**
+ * Allocate the buffer, if the panels are double buffered and there is enough
+ * SRAM left for the command queue.
+ * Return error code
+ */
+int init_jitter();
+
+/**
+ * Drop any frames waiting to be shown
+ */
+void jitter_clear();
+
+/**
+ * Whether frames are waiting to be shown
+ */
+bool jitter_pending();
+
+/**
+ * Show the pixels written so far at show_time
+ */
+void jitter_schedule(unsigned long show_time);
+
+/**
+ * Show the latest frame whose time has come, called from loop().
+ * Older frames that are also due are dropped and counted as late.
+ */
+void jitter_service();
+
+#endif /* __JITTER_H__ */
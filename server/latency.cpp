@@ -0,0 +1,30 @@
+#include "latency.h"
+
+#if LATENCY_HISTOGRAMS
+    LatencyHistogram latency_histograms[LATENCY_STAGES];
+#endif
+
+const char *const latency_stage_names[LATENCY_STAGES] = {
+    "ingest", "validate", "parse", "dispatch", "decode", "show"
+};
+
+#if HAS_CYCLE_COUNTER
+    const unsigned long latency_ticks_per_second = F_CPU;
+#else
+    const unsigned long latency_ticks_per_second = 1000000;
+#endif
+
+void init_latency() {
+    #if HAS_CYCLE_COUNTER
+        // The cycle counter is part of the debug unit, which has to be enabled first
+        ARM_DEMCR |= ARM_DEMCR_TRCENA;
+        ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+    #endif
+    reset_latency();
+}
+
+void reset_latency() {
+    #if LATENCY_HISTOGRAMS
+        memset(latency_histograms, 0, sizeof(latency_histograms));
+    #endif
+}
@@ -0,0 +1,100 @@
+/**
+ * Latency Histograms
+ * Always on timing of each stage on the path from a command arriving to its
+ * pixels being shown, kept as log2 histograms in SRAM, so measuring doesn't
+ * print anything between the commands it measures like DEBUG_TIMING does.
+ *
+ *   ingest    reading and scanning a line or frame, over the loops it takes to arrive
+ *   validate  validate_serial_special_fields() of a line
+ *   parse     GCodeParser::parse() of a queued line
+ *   dispatch  running a parsed command or binary frame, including its decode and show
+ *   decode    decoding a pixel payload, including payloads streamed while they are ingested
+ *   show      handing panels to the output backend, a panel at a time when pipelined
+ *
+ * Times are in ticks of the DWT cycle counter (F_CPU per second) on boards
+ * that have one, or of micros() otherwise. Bucket b counts the times from
+ * 2^(b-1) to 2^b - 1 ticks, bucket 0 counts times of 0 ticks, and the last
+ * bucket counts everything longer.
+ *
+ * Queried with P2622, reset with M2622.
+ */
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <Arduino.h>
+#include "config.h"
+#include "macros.h"
+
+#define LATENCY_INGEST 0
+#define LATENCY_VALIDATE 1
+#define LATENCY_PARSE 2
+#define LATENCY_DISPATCH 3
+#define LATENCY_DECODE 4
+#define LATENCY_SHOW 5
+#define LATENCY_STAGES 6
+
+// One bucket per bit of a time in ticks
+#define LATENCY_BUCKETS 32
+
+typedef struct {
+    unsigned long count;                        // Times recorded
+    unsigned long max;                          // Longest time in ticks
+    unsigned long buckets[LATENCY_BUCKETS];     // Times recorded in each power of 2 of ticks
+} LatencyHistogram;
+
+#if LATENCY_HISTOGRAMS
+    extern LatencyHistogram latency_histograms[LATENCY_STAGES];
+#endif
+
+// Name of each stage, as reported by P2622
+extern const char *const latency_stage_names[LATENCY_STAGES];
+
+// Ticks per second of latency_ticks()
+extern const unsigned long latency_ticks_per_second;
+
+/**
+ * Start the cycle counter if there is one, and clear the histograms
+ */
+void init_latency();
+
+/**
+ * Clear the histograms
+ */
+void reset_latency();
+
+/**
+ * The clock stages are timed with, in ticks, wrapping at 32 bits
+ */
+inline uint32_t latency_ticks() {
+    #if HAS_CYCLE_COUNTER
+        return ARM_DWT_CYCCNT;
+    #else
+        return micros();
+    #endif
+}
+
+/**
+ * Record a time a stage took in ticks
+ */
+inline void latency_record_ticks(int stage, uint32_t ticks) {
+    #if LATENCY_HISTOGRAMS
+        LatencyHistogram *histogram = &latency_histograms[stage];
+        // clzl as int is 16 bits on AVR
+        const int bits = ticks ? 8 * (int)sizeof(unsigned long) - __builtin_clzl(ticks) : 0;
+        histogram->buckets[MIN(bits, LATENCY_BUCKETS - 1)]++;
+        histogram->count++;
+        if (ticks > histogram->max) {
+            histogram->max = ticks;
+        }
+    #endif
+}
+
+/**
+ * Record the time a stage took since started, a latency_ticks() value
+ */
+inline void latency_record(int stage, uint32_t started) {
+    latency_record_ticks(stage, latency_ticks() - started);
+}
+
+#endif /* __LATENCY_H__ */
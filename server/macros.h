@@ -34,6 +34,9 @@
 #ifndef MIN
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 #endif
+#ifndef MAX
+#define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
+#endif
 
 #define HAS_NUM(p) (\
     NUMERIC(p[0]) \
@@ -0,0 +1,64 @@
+#include "output.h"
+#include "panel.h"
+#include "serial.h"
+#include "utility.h"
+
+const OutputBackend *output_backend;
+int output_backend_index;
+long output_recorded = 0;
+
+OutputRecord *output_records = NULL;    // Ring of OUTPUT_RECORD_SIZE records
+
+void show_fastled(unsigned int mask) {
+    for (int panel = 0; panel < panel_count; panel++) {
+        if (mask & (1 << panel)) {
+            FastLED[panel].showLeds(FastLED.getBrightness());
+        }
+    }
+}
+
+void show_null(unsigned int mask) {
+}
+
+void show_recording(unsigned int mask) {
+    unsigned long now = micros();
+    for (int panel = 0; panel < panel_count; panel++) {
+        if (!(mask & (1 << panel))) {
+            continue;
+        }
+        OutputRecord *record = &output_records[output_recorded % OUTPUT_RECORD_SIZE];
+        record->time = now;
+        record->panel = panel;
+        record->checksum = 0;
+        crc16(&record->checksum, shown_panels[panel], panel_info[panel] * sizeof(CRGB));
+        output_recorded++;
+    }
+}
+
+const OutputBackend output_backends[] = {
+    { "FASTLED", show_fastled },
+    { "NULL", show_null },
+    { "RECORDING", show_recording },
+};
+
+int set_output_backend(int index) {
+    if (index == OUTPUT_RECORDING && !output_records) {
+        output_records = (OutputRecord *)malloc(OUTPUT_RECORD_SIZE * sizeof(OutputRecord));
+        if (!output_records) {
+            SNPRINTF_MSG_PSTR("malloc failed for output records: %d bytes", (int)(OUTPUT_RECORD_SIZE * sizeof(OutputRecord)));
+            return 2;
+        }
+    }
+    output_recorded = 0;
+    output_backend_index = index;
+    output_backend = &output_backends[index];
+    return 0;
+}
+
+const OutputRecord *output_record(int n) {
+    long first = max(0L, output_recorded - OUTPUT_RECORD_SIZE);
+    if (!output_records || first + n >= output_recorded) {
+        return NULL;
+    }
+    return &output_records[(first + n) % OUTPUT_RECORD_SIZE];
+}
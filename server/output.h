@@ -0,0 +1,72 @@
+/**
+ * Output Backends
+ * Where shown pixels go when the panels are shown.
+ *
+ * Commands write pixels to the panel buffers, and showing hands a mask of
+ * panels to the selected backend, which reads their pixels from shown_panels.
+ * The FastLED backend clocks them out to the LEDs, the null backend drops them,
+ * so the protocol path can be measured without the LED path, and the recording
+ * backend keeps the time and a checksum of each panel shown in a ring buffer,
+ * so what was shown can be checked without hardware.
+ *
+ * Selected with M2616, dumped with P2616.
+ */
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <Arduino.h>
+#include "config.h"
+#include "latency.h"
+#include "trace.h"
+
+#define OUTPUT_FASTLED 0
+#define OUTPUT_NULL 1
+#define OUTPUT_RECORDING 2
+
+/**
+ * Show the panels in a mask, one bit per panel
+ */
+typedef void (*output_show_fn)(unsigned int mask);
+
+struct OutputBackend {
+    const char *name;
+    output_show_fn show;
+};
+
+// A panel shown by the recording backend
+struct OutputRecord {
+    unsigned long time;     // micros() when it was shown
+    uint8_t panel;
+    uint16_t checksum;      // crc16 of the panel's shown pixels
+};
+
+extern const OutputBackend *output_backend;
+extern int output_backend_index;
+
+// Panels shown by the recording backend since it was selected, including those overwritten in the ring
+extern long output_recorded;
+
+/**
+ * Select a backend, one of OUTPUT_*
+ * Return error code
+ */
+int set_output_backend(int index);
+
+/**
+ * Show the panels in mask with the selected backend
+ */
+inline void output_show(unsigned int mask) {
+    trace_event(TRACE_SHOW_START, mask);
+    const uint32_t started = latency_ticks();
+    output_backend->show(mask);
+    latency_record(LATENCY_SHOW, started);
+    trace_event(TRACE_SHOW_END, mask);
+}
+
+/**
+ * The recording backend's nth oldest record still in the ring, NULL if there are not that many
+ */
+const OutputRecord *output_record(int n);
+
+#endif /* __OUTPUT_H__ */
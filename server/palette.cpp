@@ -0,0 +1,82 @@
+#include "palette.h"
+#include "panel.h"
+#include "serial.h"
+#include "debug.h"
+
+CRGB *global_palette = NULL;
+CRGB *panel_palettes[MAX_PANELS];
+
+int set_palette_entries(int panel, int entry_offset, char *rgb_data, int entries) {
+    CRGB **palette = (panel == GLOBAL_PALETTE) ? &global_palette : &panel_palettes[panel];
+    if (!*palette) {
+        const int bytes = PALETTE_SIZE * sizeof(CRGB);
+        // Leave the reserve the command queue was sized to keep free for the stack
+        if (getFreeSram() - QUEUE_SRAM_RESERVE < bytes) {
+            SNPRINTF_MSG_PSTR("not enough SRAM for palette: %d bytes", bytes);
+            return 2;
+        }
+        *palette = (CRGB *)malloc(bytes);
+        if (!*palette) {
+            SNPRINTF_MSG_PSTR("malloc failed for palette: %d bytes", bytes);
+            return 2;
+        }
+        fill_solid(*palette, PALETTE_SIZE, CRGB(0, 0, 0));
+    }
+    for (int entry = 0; entry < entries; entry++) {
+        char *pixel_data = rgb_data + (entry * 3);
+        (*palette)[entry_offset + entry].setRGB(
+            (uint8_t)pixel_data[0],
+            (uint8_t)pixel_data[1],
+            (uint8_t)pixel_data[2]
+        );
+    }
+    return 0;
+}
+
+CRGB *get_palette(int panel) {
+    if (panel_palettes[panel]) {
+        return panel_palettes[panel];
+    }
+    return global_palette;
+}
+
+int write_panel_indexed(int panel, int pixel_offset, int bits, const char *indices, int pixels) {
+    const CRGB *palette = get_palette(panel);
+    if (!palette) {
+        SNPRINTF_MSG_PSTR("no palette uploaded for panel %d", panel);
+        return 14;
+    }
+    const uint8_t mask = (1 << bits) - 1;
+    #if PALETTE_SIZE < 256
+        if ((1 << bits) > PALETTE_SIZE) {
+            // Indices can be past the end of the palette, check them all before writing anything
+            for (int pixel = 0; pixel < pixels; pixel++) {
+                const int bit = pixel * bits;
+                const int index = ((uint8_t)indices[bit >> 3] >> (8 - bits - (bit & 7))) & mask;
+                if (index >= PALETTE_SIZE) {
+                    SNPRINTF_MSG_PSTR("palette index %d out of range at pixel %d", index, pixel);
+                    return 14;
+                }
+            }
+        }
+    #endif
+    CRGB *pixels_out = panels[panel] + pixel_offset;
+    if (bits == 8) {
+        for (int pixel = 0; pixel < pixels; pixel++) {
+            pixels_out[pixel] = palette[(uint8_t)indices[pixel]];
+        }
+    } else {
+        // Unpack each byte from the most significant bits down
+        const int per_byte = 8 / bits;
+        for (int pixel = 0; pixel < pixels; indices++) {
+            uint8_t packed = *indices;
+            for (int i = 0; (i < per_byte) && (pixel < pixels); i++, pixel++) {
+                packed = (packed << bits) | (packed >> (8 - bits));
+                pixels_out[pixel] = palette[packed & mask];
+            }
+        }
+    }
+    mark_panel_dirty(panel, pixel_offset, pixel_offset + pixels);
+    pixels_set += pixels;
+    return 0;
+}
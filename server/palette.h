@@ -0,0 +1,43 @@
+/**
+ * Palettes
+ * Colour tables that indexed pixel payloads are expanded through.
+ *
+ * There is a global palette, and each panel can have its own palette which
+ * is used instead of the global one. Palettes are allocated when they are
+ * first uploaded. Indexed pixels are copied straight into the panel, and
+ * colour corrected when they are shown, like any other pixels.
+ */
+
+#ifndef __PALETTE_H__
+#define __PALETTE_H__
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "config.h"
+
+// Panel number of the global palette
+#define GLOBAL_PALETTE -1
+
+/**
+ * Set palette entries from RGB data, 3 bytes per entry, starting at entry_offset.
+ * panel is a panel number or GLOBAL_PALETTE.
+ * Parameters must already be validated.
+ * Return error code
+ */
+int set_palette_entries(int panel, int entry_offset, char *rgb_data, int entries);
+
+/**
+ * The palette used by a panel, NULL if none has been uploaded
+ */
+CRGB *get_palette(int panel);
+
+/**
+ * Expand indices through the panel's palette into the panel, starting at pixel_offset.
+ * Indices are bits wide (1, 2, 4 or 8), packed from the most significant bit first.
+ * Parameters must already be validated.
+ * Return error code
+ */
+int write_panel_indexed(int panel, int pixel_offset, int bits, const char *indices, int pixels);
+
+#endif /* __PALETTE_H__ */
@@ -1,6 +1,9 @@
 #include <Arduino.h>
 
 #include "panel.h"
+#include "jitter.h"
+#include "output.h"
+#include "correction.h"
 
 /**
  * Panels
@@ -21,61 +24,24 @@ int pixels_set = 0;
 
 CRGB **panels = NULL;
 
-// Gamma correction
-const uint8_t PROGMEM gammaR[] = {
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,
-    1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,
-    2,  2,  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,
-    5,  5,  5,  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,
-    9,  9, 10, 10, 10, 11, 11, 11, 12, 12, 12, 13, 13, 14, 14, 14,
-   15, 15, 16, 16, 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22,
-   23, 24, 24, 25, 25, 26, 27, 27, 28, 29, 29, 30, 31, 31, 32, 33,
-   33, 34, 35, 36, 36, 37, 38, 39, 40, 40, 41, 42, 43, 44, 45, 46,
-   46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61,
-   62, 63, 65, 66, 67, 68, 69, 70, 71, 73, 74, 75, 76, 78, 79, 80,
-   81, 83, 84, 85, 87, 88, 89, 91, 92, 94, 95, 97, 98, 99,101,102,
-  104,105,107,109,110,112,113,115,116,118,120,121,123,125,127,128,
-  130,132,134,135,137,139,141,143,145,146,148,150,152,154,156,158,
-  160,162,164,166,168,170,172,174,177,179,181,183,185,187,190,192,
-  194,196,199,201,203,206,208,210,213,215,218,220,223,225,227,230 };
-
-const uint8_t PROGMEM gammaG[] = {
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
-    1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
-    2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
-    5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
-   10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
-   17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
-   25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
-   37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
-   51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
-   69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
-   90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
-  115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
-  144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
-  177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
-  215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255 };
-
-
-const uint8_t PROGMEM gammaB[] = {
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,
-    1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,
-    2,  2,  2,  2,  2,  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,
-    4,  4,  5,  5,  5,  5,  5,  6,  6,  6,  6,  6,  7,  7,  7,  8,
-    8,  8,  8,  9,  9,  9, 10, 10, 10, 10, 11, 11, 12, 12, 12, 13,
-   13, 13, 14, 14, 15, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19, 19,
-   20, 20, 21, 22, 22, 23, 23, 24, 24, 25, 25, 26, 27, 27, 28, 28,
-   29, 30, 30, 31, 32, 32, 33, 34, 34, 35, 36, 37, 37, 38, 39, 40,
-   40, 41, 42, 43, 44, 44, 45, 46, 47, 48, 49, 50, 51, 51, 52, 53,
-   54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 69, 70,
-   71, 72, 73, 74, 75, 77, 78, 79, 80, 81, 83, 84, 85, 86, 88, 89,
-   90, 92, 93, 94, 96, 97, 98,100,101,103,104,106,107,109,110,112,
-  113,115,116,118,119,121,122,124,126,127,129,131,132,134,136,137,
-  139,141,143,144,146,148,150,152,153,155,157,159,161,163,165,167,
-  169,171,173,175,177,179,181,183,185,187,189,191,193,196,198,200 };
+CRGB *shown_panels[MAX_PANELS];
+
+bool double_buffered = false;
+
+// Uncorrected pixels of the panel being output while single buffered, as long as the longest panel
+CRGB *output_scratch = NULL;
+
+bool frame_open = false;
+
+int dirty_start[MAX_PANELS];
+int dirty_end[MAX_PANELS];
+
+unsigned int panels_changed = 0;
+
+unsigned int panels_outputting = 0;
+unsigned long output_started;
+unsigned long output_busy_us = 0;
+unsigned long output_window_us = 0;
 
 /**
  * Called when initializing panels at setup()
@@ -118,21 +84,194 @@ int init_panels()
 #endif
     panel_count++;
 
-
-    // TODO: set this with GCode
-    FastLED.setBrightness(MAX_BRIGHTNESS);
+panels_done:
+    #if DOUBLE_BUFFER
+        init_back_buffers();
+    #endif
+    if (!double_buffered && panel_count) {
+        int longest = 0;
+        for (int panel = 0; panel < panel_count; panel++) {
+            longest = max(longest, panel_info[panel]);
+        }
+        output_scratch = (CRGB *)malloc(longest * sizeof(CRGB));
+        if (!output_scratch) {
+            SNPRINTF_MSG_PSTR("malloc failed for output scratch, %d pixels", longest);
+            return 2;
+        }
+    }
 
     return reinit_panels();
 }
 
+/**
+ * Give each panel a back buffer for commands to write to, the buffers given
+ * to FastLED become the shown buffers.
+ * The panels are left single buffered if there isn't enough SRAM left for the command queue.
+ */
+void init_back_buffers() {
+    if (getFreeSram() - QUEUE_SRAM_RESERVE - QUEUE_MIN_SIZE < pixel_count * (int)sizeof(CRGB)) {
+        SER_SNPRINTF_COMMENT_PSTR("PAN: not enough SRAM for back buffers, %d pixels", pixel_count);
+        return;
+    }
+    CRGB *back_buffers[MAX_PANELS];
+    for (int panel = 0; panel < panel_count; panel++) {
+        back_buffers[panel] = (CRGB *)malloc(panel_info[panel] * sizeof(CRGB));
+        if (!back_buffers[panel]) {
+            while (panel--) {
+                free(back_buffers[panel]);
+            }
+            SER_SNPRINTF_COMMENT_PSTR("PAN: malloc failed for back buffers, %d pixels", pixel_count);
+            return;
+        }
+    }
+    for (int panel = 0; panel < panel_count; panel++) {
+        memcpy(back_buffers[panel], shown_panels[panel], panel_info[panel] * sizeof(CRGB));
+        panels[panel] = back_buffers[panel];
+    }
+    double_buffered = true;
+}
+
 /**
  * Called by init_panels when initializing panels at setup() or at sw_reset()
  */
 int reinit_panels() {
     pixels_set = 0;
+    frame_open = false;
+    finish_output();
+    panels_changed = 0;
+    for (int panel = 0; panel < panel_count; panel++) {
+        dirty_start[panel] = panel_info[panel];
+        dirty_end[panel] = 0;
+    }
     return 0;
 }
 
+/**
+ * Copy the pixels written to one back buffer to its shown buffer, colour correcting them.
+ * Single buffered panels are corrected as they are output instead, see output_single_buffered.
+ */
+void sync_panel(int panel) {
+    if (dirty_start[panel] >= dirty_end[panel]) {
+        return;
+    }
+    if (double_buffered) {
+        correct_pixels(
+            panel,
+            shown_panels[panel] + dirty_start[panel],
+            panels[panel] + dirty_start[panel],
+            dirty_end[panel] - dirty_start[panel]
+        );
+    }
+    dirty_start[panel] = panel_info[panel];
+    dirty_end[panel] = 0;
+    panels_changed |= 1 << panel;
+}
+
+void sync_panels() {
+    for (int panel = 0; panel < panel_count; panel++) {
+        sync_panel(panel);
+    }
+}
+
+/**
+ * Output single buffered panels one at a time, colour corrected in place for as long as
+ * they are output, so that the panels keep the pixels as they were written.
+ */
+void output_single_buffered(unsigned int mask) {
+    for (int panel = 0; panel < panel_count; panel++) {
+        if (!(mask & (1 << panel))) {
+            continue;
+        }
+        const int bytes = panel_info[panel] * sizeof(CRGB);
+        memcpy(output_scratch, panels[panel], bytes);
+        correct_pixels(panel, panels[panel], output_scratch, panel_info[panel]);
+        output_show(1 << panel);
+        memcpy(panels[panel], output_scratch, bytes);
+    }
+}
+
+/**
+ * Clock out the panels in mask to the LEDs, in the background if the show is pipelined
+ */
+void output_panels(unsigned int mask) {
+    panels_changed &= ~mask;
+    if (!double_buffered) {
+        output_single_buffered(mask);
+        FastLED.countFPS();
+        return;
+    }
+    #if PIPELINED_SHOW
+        panels_outputting = mask;
+        output_started = micros();
+    #else
+        output_show(mask);
+        FastLED.countFPS();
+    #endif
+}
+
+void show_panels() {
+    #if SHOW_CHANGED_ONLY
+        show_changed_panels();
+    #else
+        finish_output();
+        // Frames waiting in the jitter buffer are shown from their snapshots
+        if (!frame_open && !jitter_pending()) {
+            sync_panels();
+        }
+        output_panels((1U << panel_count) - 1);
+    #endif
+}
+
+void show_panel(int panel) {
+    finish_output();
+    if (!frame_open && !jitter_pending()) {
+        sync_panel(panel);
+    }
+    output_panels(1 << panel);
+}
+
+void show_changed_panels() {
+    finish_output();
+    if (!frame_open && !jitter_pending()) {
+        sync_panels();
+    }
+    output_panels(panels_changed);
+}
+
+void output_service() {
+    if (!panels_outputting) {
+        return;
+    }
+    int panel = 0;
+    while (!(panels_outputting & (1 << panel))) {
+        panel++;
+    }
+    unsigned long started = micros();
+    output_show(1 << panel);
+    output_busy_us += micros() - started;
+    panels_outputting &= ~(1 << panel);
+    if (!panels_outputting) {
+        output_window_us += micros() - output_started;
+        FastLED.countFPS();
+    }
+}
+
+void finish_output() {
+    while (panels_outputting) {
+        output_service();
+    }
+}
+
+int take_output_overlap() {
+    int overlap = 0;
+    if (output_window_us) {
+        overlap = (int)(100.0 * (output_window_us - output_busy_us) / output_window_us);
+    }
+    output_window_us = 0;
+    output_busy_us = 0;
+    return overlap;
+}
+
 int set_panel_pixel_RGB(int panel, int pixel, char * pixel_data){
     const char * debug_prefix = "PIX";
 
@@ -143,20 +282,27 @@ int set_panel_pixel_RGB(int panel, int pixel, char * pixel_data){
             (uint8_t)pixel_data[0], (uint8_t)pixel_data[1], (uint8_t)pixel_data[2]
         );
     #endif
-    #if ENABLE_GAMMA_CORRECTION
-    pixel_data[0] = pgm_read_byte(&gammaR[(uint8_t)(pixel_data[0])]);
-    pixel_data[1] = pgm_read_byte(&gammaG[(uint8_t)(pixel_data[1])]);
-    pixel_data[2] = pgm_read_byte(&gammaB[(uint8_t)(pixel_data[2])]);
-    #endif
     panels[panel][pixel].setRGB(
         (uint8_t)pixel_data[0],
         (uint8_t)pixel_data[1],
         (uint8_t)pixel_data[2]
     );
+    mark_panel_dirty(panel, pixel, pixel + 1);
     pixels_set++;
     return 0;
 }
 
+int decode_panel_pixels_RGB(int panel, int pixel, const char *encoded, int encoded_len) {
+    // CRGB is laid out as 3 bytes, r, g, b, the same as the decoded payload
+    const int dec_len = base64_decode((char *)(panels[panel] + pixel), encoded, encoded_len);
+    const int pixels = (dec_len >= 0) ? (dec_len / 3) : ((-1 - dec_len) / 4);
+    if (pixels > 0) {
+        mark_panel_dirty(panel, pixel, pixel + pixels);
+        pixels_set += pixels;
+    }
+    return dec_len;
+}
+
 int set_panel_pixel_HSV(int panel, int pixel, char * pixel_data){
     const char * debug_prefix = "PIX";
 
@@ -172,6 +318,7 @@ int set_panel_pixel_HSV(int panel, int pixel, char * pixel_data){
         (uint8_t)pixel_data[1],
         (uint8_t)pixel_data[2]
     );
+    mark_panel_dirty(panel, pixel, pixel + 1);
     pixels_set++;
     return 0;
 }
@@ -191,3 +338,24 @@ int set_panel_HSV(int panel, char * pixel_data, int offset) {
     }
     return 0;
 }
+
+int save_panel(int panel, PanelSnapshot *snapshot) {
+    const int bytes = panel_info[panel] * sizeof(CRGB);
+    snapshot->pixels = (CRGB *)malloc(bytes);
+    if (!snapshot->pixels) {
+        SNPRINTF_MSG_PSTR("malloc failed for panel copy: %d bytes", bytes);
+        return 2;
+    }
+    memcpy(snapshot->pixels, panels[panel], bytes);
+    snapshot->dirty_start = dirty_start[panel];
+    snapshot->dirty_end = dirty_end[panel];
+    return 0;
+}
+
+void restore_panel(int panel, PanelSnapshot *snapshot) {
+    memcpy(panels[panel], snapshot->pixels, panel_info[panel] * sizeof(CRGB));
+    dirty_start[panel] = snapshot->dirty_start;
+    dirty_end[panel] = snapshot->dirty_end;
+    free(snapshot->pixels);
+    snapshot->pixels = NULL;
+}
@@ -22,8 +22,40 @@ extern int pixel_count;
 extern int pixels_set;
 
 // An array of arrays of pixels, populated in setup()
+// These are the pixels that commands write to.
 extern CRGB **panels;
 
+// The pixels that the LEDs are shown from. The same as panels unless double buffered.
+extern CRGB *shown_panels[MAX_PANELS];
+
+// Whether panels has back buffers
+extern bool double_buffered;
+
+// Whether a frame has begun and not been committed, the back buffers aren't shown until it is
+extern bool frame_open;
+
+// Range of pixels in each back buffer written since it was last shown, empty if start >= end
+extern int dirty_start[MAX_PANELS];
+extern int dirty_end[MAX_PANELS];
+
+// One bit per panel whose shown pixels have changed since it was last clocked out to the LEDs
+extern unsigned int panels_changed;
+
+// One bit per panel still to be clocked out by a pipelined show
+extern unsigned int panels_outputting;
+
+/**
+ * Mark a range of pixels in a panel as written, so that it is shown
+ */
+inline void mark_panel_dirty(int panel, int start, int end) {
+    if (start < dirty_start[panel]) {
+        dirty_start[panel] = start;
+    }
+    if (end > dirty_end[panel]) {
+        dirty_end[panel] = end;
+    }
+}
+
 // Macro function to determine if pin is valid.
 // TODO: define MAX_PIN in config
 #define VALID_PIN(pin) ((pin) > 0)
@@ -33,7 +65,7 @@ extern CRGB **panels;
  * This is kind of bullshit but you have to define the pins like this
  * because FastLED.addLeds needs to know the pin numbers at compile time.
  * Panels must be contiguous. The firmware stops defining panels after the
- * first undefined panel.
+ * first undefined panel, jumping to panels_done in init_panels.
  */
 
 #define INIT_PANEL(data_pin, clk_pin, len)                                                                                               \
@@ -41,7 +73,7 @@ extern CRGB **panels;
     if (!VALID_PIN((data_pin)) || (len) <= 0)                                                                                            \
     {                                                                                                                                    \
         SER_SNPRINTF_COMMENT_PSTR("PANEL_%02d not configured", panel_count);                                                           \
-        return 0;                                                                                                                        \
+        goto panels_done;                                                                                                                \
     }                                                                                                                                    \
     SER_SNPRINTF_COMMENT_PSTR("PAN: initializing PANEL_%02d, data_pin: %d, clk_pin: %d, len: %d", panel_count, (data_pin), (clk_pin), (len)); \
     panel_info[panel_count] = (len);                                                                                                     \
@@ -51,19 +83,97 @@ extern CRGB **panels;
     {                                                                                                                                    \
         SNPRINTF_MSG_PSTR("malloc failed for PANEL_%02d", panel_count);                                                                  \
         return 2;                                                                                                                       \
-    }
+    }                                                                                                                                    \
+    shown_panels[panel_count] = panels[panel_count];
 
 int init_panels();
 
 int reinit_panels();
 
+void init_back_buffers();
+
+/**
+ * Copy the pixels written to the back buffers to the shown buffers, colour correcting them.
+ * Panels always hold the pixels as written, single buffered panels are corrected as they are output.
+ */
+void sync_panels();
+
+/**
+ * Show the panels on the LEDs, with the back buffers unless a frame is open
+ * or timed frames are waiting to be shown.
+ * Only clocks out the panels that changed with SHOW_CHANGED_ONLY.
+ */
+void show_panels();
+
+/**
+ * Show one panel on its LEDs, like show_panels
+ */
+void show_panel(int panel);
+
+/**
+ * Show only the panels that changed since they were last shown, like show_panels
+ */
+void show_changed_panels();
+
+/**
+ * Pipelined Show
+ * With PIPELINED_SHOW and back buffers, showing only syncs the shown buffers,
+ * and loop() clocks out one panel at a time, receiving commands in between.
+ * Commands write to the back buffers meanwhile, and the next show, or anything
+ * else that changes the shown buffers, finishes clocking out the last one first.
+ */
+
+/**
+ * Clock out the next panel of a pipelined show, called from loop()
+ */
+void output_service();
+
+/**
+ * Clock out the rest of a pipelined show
+ */
+void finish_output();
+
+/**
+ * The percentage of the time pipelined shows took that went to other work,
+ * since this was last called
+ */
+int take_output_overlap();
+
 int set_panel_pixel_RGB(int panel, int pixel, char * pixel_data);
 
+/**
+ * Decode base64 RGB pixels, 4 characters each, straight into a panel starting at pixel.
+ * The pixels must fit in the panel.
+ * Return base64_decode's result, the pixels before an invalid character are still set,
+ * so payloads that may be invalid are checked with base64_validate first
+ */
+int decode_panel_pixels_RGB(int panel, int pixel, const char *encoded, int encoded_len);
+
 int set_panel_pixel_HSV(int panel, int pixel, char * pixel_data);
 
 int set_panel_RGB(int panel, char * pixel_data, int offset);
 
 int set_panel_HSV(int panel, char * pixel_data, int offset);
 
+/**
+ * A copy of a panel's pixels and dirty range, so that benchmarks can write to the panel
+ */
+typedef struct {
+    CRGB *pixels;
+    int dirty_start;
+    int dirty_end;
+} PanelSnapshot;
+
+/**
+ * Copy a panel into snapshot
+ * Return error code
+ */
+int save_panel(int panel, PanelSnapshot *snapshot);
+
+/**
+ * Put a panel back as it was saved, and free the copy
+ */
+void restore_panel(int panel, PanelSnapshot *snapshot);
+
 
 #endif /* __PANEL_H__ */
@@ -1,23 +1,62 @@
 #include "queue.h"
 #include "serial.h"
+#include "debug.h"
+#include "macros.h"
 
-uint8_t cmd_queue_index_r, // Ring buffer read position
-    cmd_queue_index_w;            // Ring buffer write position
-char command_queue[MAX_QUEUE_LEN][MAX_CMD_SIZE];
-bool queue_full;
+char *command_queue = NULL;     // The arena
+int queue_size;                 // Size of the arena in bytes
+int queue_max_cmd_size;         // Longest command that fits in the arena, including terminator
+int queue_head,                 // Offset of the oldest record
+    queue_tail;                 // Offset where the next record will be written
+int queue_count;                // Number of records in the queue
+int queue_reserved = -1;        // Offset of the reserved record, -1 if none
+const void *queue_reserved_owner = NULL;
 long this_linenum; // The linenum of the command being currently parsed
 long last_linenum; // the last linenum that was parsed
 long idle_linenum; // the last linenum where an idle was printed
 long long int commands_processed;
+bool flow_control_enabled = false;
+
+// Records are kept aligned to the header so it can be accessed directly
+#define QUEUE_ALIGNED_SIZE(len) ((QUEUE_RECORD_SIZE(len) + sizeof(queue_record_t) - 1) & ~(sizeof(queue_record_t) - 1))
+
+inline queue_record_t *queue_record_at(int offset) {
+    return (queue_record_t *)(command_queue + offset);
+}
+
+/**
+ * Skip over a wrap marker, or a gap too small for a marker, at the end of the arena
+ */
+inline int queue_unwrap(int offset) {
+    if ((queue_size - offset < (int)sizeof(queue_record_t))
+        || (queue_record_at(offset)->len == QUEUE_WRAP_MARKER)) {
+        return 0;
+    }
+    return offset;
+}
 
 /**
  * Init Queue
- * Stub for when queue is rewritten to be more sophisticated w dynamic allocation
+ * The arena is sized from the free SRAM the first time this is called,
+ * after the panels have been allocated, and reused on sw_reset()
  */
 int init_queue(){
-    cmd_queue_index_r = 0;
-    cmd_queue_index_w = 0;
-    queue_full = false;
+    if (!command_queue) {
+        queue_size = getFreeSram() - QUEUE_SRAM_RESERVE;
+        NOMORE(queue_size, QUEUE_MAX_SIZE);
+        queue_size &= ~(sizeof(queue_record_t) - 1);
+        if (queue_size < QUEUE_MIN_SIZE) {
+            SNPRINTF_MSG_PSTR("Not enough SRAM for command queue: %d bytes", queue_size);
+            return 2;
+        }
+        command_queue = (char *)malloc(queue_size);
+        if (!command_queue) {
+            SNPRINTF_MSG_PSTR("malloc failed for command queue: %d bytes", queue_size);
+            return 2;
+        }
+    }
+    queue_max_cmd_size = MIN(MAX_CMD_SIZE, queue_size - (int)sizeof(queue_record_t));
+    queue_clear();
     this_linenum = 0;
     last_linenum = 0;
     idle_linenum = -1;
@@ -25,9 +64,120 @@ int init_queue(){
     return 0;
 }
 
+int queue_write_offset(int len) {
+    const int need = QUEUE_ALIGNED_SIZE(len);
+    if (!queue_count) {
+        return (need <= queue_size) ? 0 : -1;
+    }
+    if (queue_tail > queue_head) {
+        if (queue_size - queue_tail >= need) {
+            return queue_tail;
+        }
+        // Wrap to the start of the arena
+        return (queue_head >= need) ? 0 : -1;
+    }
+    if ((queue_tail < queue_head) && (queue_head - queue_tail >= need)) {
+        return queue_tail;
+    }
+    return -1;
+}
+
 /**
- * Push a command onto the end of the command queue
+ * Get the sizes of the free regions of the arena that records can be written to.
+ * Records never straddle the end of the arena, so there are at most two.
  */
+int queue_free_regions(int *regions) {
+    if (!queue_count) {
+        regions[0] = queue_size;
+        return 1;
+    }
+    if (queue_tail > queue_head) {
+        regions[0] = queue_size - queue_tail;
+        regions[1] = queue_head;
+        return 2;
+    }
+    regions[0] = queue_head - queue_tail;
+    return 1;
+}
+
+int queue_free_slots() {
+    const int need = QUEUE_ALIGNED_SIZE(queue_max_cmd_size - 1);
+    int regions[2];
+    int slots = 0;
+    for (int i = queue_free_regions(regions) - 1; i >= 0; i--) {
+        slots += regions[i] / need;
+    }
+    return slots;
+}
+
+int queue_free_bytes() {
+    int regions[2];
+    int bytes = 0;
+    for (int i = queue_free_regions(regions) - 1; i >= 0; i--) {
+        bytes += regions[i];
+    }
+    return bytes;
+}
+
+char *queue_peek() {
+    if (!queue_count) {
+        return NULL;
+    }
+    queue_head = queue_unwrap(queue_head);
+    return (char *)(queue_record_at(queue_head) + 1);
+}
+
+void queue_advance_read() {
+    if (!queue_count) {
+        // If the queue was previously empty, don't do anything
+        return;
+    }
+    queue_head = queue_unwrap(queue_head);
+    queue_head += QUEUE_ALIGNED_SIZE(queue_record_at(queue_head)->len);
+    queue_count--;
+    if (!queue_count && queue_reserved < 0) {
+        // Start from the beginning so the whole arena is contiguous
+        queue_clear();
+    }
+}
+
+char *queue_reserve(const void *owner, int len) {
+    if (queue_reserved < 0) {
+        int offset = queue_write_offset(len);
+        if (offset < 0) {
+            return NULL;
+        }
+        queue_reserved = offset;
+        queue_reserved_owner = owner;
+    } else if (queue_reserved_owner != owner) {
+        return NULL;
+    }
+    return (char *)(queue_record_at(queue_reserved) + 1);
+}
+
+bool queue_commit(const void *owner, int len) {
+    if ((queue_reserved < 0) || (queue_reserved_owner != owner)) {
+        return false;
+    }
+    const int offset = queue_reserved;
+    queue_reserved = -1;
+    if (!queue_count) {
+        queue_head = offset;
+    } else if ((offset != queue_tail) && (queue_size - queue_tail >= (int)sizeof(queue_record_t))) {
+        queue_record_at(queue_tail)->len = QUEUE_WRAP_MARKER;
+    }
+    queue_record_at(offset)->len = len;
+    queue_tail = offset + QUEUE_ALIGNED_SIZE(len);
+    queue_count++;
+    return true;
+}
+
+void queue_release(const void *owner) {
+    if (queue_reserved_owner == owner) {
+        queue_reserved = -1;
+    }
+}
+
 bool enqueue_command(const char* cmd) {
     const char *debug_prefix = "ENQ";
     #if DEBUG_QUEUE
@@ -36,10 +186,16 @@ bool enqueue_command(const char* cmd) {
         );
         debug_queue(debug_prefix);
     #endif
-    if (*cmd == STRING_TERMINATOR || *cmd == COMMENT_PREFIX || queue_length() >= MAX_QUEUE_LEN)
+    if (*cmd == STRING_TERMINATOR || *cmd == COMMENT_PREFIX)
+        return false;
+    int len = strlen(cmd);
+    if (len >= queue_max_cmd_size)
+        return false;
+    char *record = queue_reserve(cmd, len);
+    if (!record)
         return false;
-    strncpy(command_queue[cmd_queue_index_w], cmd, MAX_CMD_SIZE);
-    queue_advance_write();
+    memcpy(record, cmd, len + 1);
+    queue_commit(cmd, len);
     #if DEBUG_QUEUE
         SER_SNPRINTF_COMMENT_PSTR("ENQ: Enqueued command: '%s'", cmd);
         debug_queue(debug_prefix);
@@ -50,21 +206,22 @@ bool enqueue_command(const char* cmd) {
 void debug_queue(const char* debug_prefix){
     SERIAL_OBJ.flush();
     SER_SNPRINTF_COMMENT_PSTR(
-        "%s: cmd_queue_index_r / w : %d / %d, length: %d / %d, full: %d, linenum this / last : %d / %d",
-        debug_prefix, cmd_queue_index_r, cmd_queue_index_w,
-        queue_length(), MAX_QUEUE_LEN, queue_full, this_linenum, last_linenum
+        "%s: queue_head / tail : %d / %d, length: %d, bytes: %d / %d, linenum this / last : %d / %d",
+        debug_prefix, queue_head, queue_tail,
+        queue_length(), queue_used_bytes(), queue_size, this_linenum, last_linenum
     );
     SER_SNPRINTF_COMMENT_PSTR(
-        "%s: Q: 0x%08x, QW: 0x%08x, QR: 0x%08x, MAX_CMD_SIZE: %d",
-        debug_prefix, command_queue,
-        command_queue[cmd_queue_index_w], command_queue[cmd_queue_index_r],
-        MAX_CMD_SIZE
+        "%s: Q: 0x%08x, MAX_CMD_SIZE: %d",
+        debug_prefix, command_queue, queue_max_cmd_size
     );
+    int offset = queue_head;
     for( int i = 0; i < queue_length(); i++ ){
-        const char * cmd = command_queue[(cmd_queue_index_r + i) % MAX_QUEUE_LEN];
+        offset = queue_unwrap(offset);
+        const char * cmd = (const char *)(queue_record_at(offset) + 1);
         SER_SNPRINTF_COMMENT_PSTR(
-            "%s: -> QUEUE[%d] @0x%08x = '%s'", debug_prefix, i, &cmd, cmd
+            "%s: -> QUEUE[%d] @%d = '%s'", debug_prefix, i, offset, cmd
         );
+        offset += QUEUE_ALIGNED_SIZE(queue_record_at(offset)->len);
     }
     SERIAL_OBJ.flush();
 }
@@ -1,11 +1,21 @@
 /**
  * GCode Command Queue
- * A simple ring buffer of BUFSIZE command strings.
+ * A ring buffer arena of variable length command records.
  *
  * Commands are copied into this buffer by the command injectors
  * (immediate, serial, sd card) and they are processed sequentially by
  * the main loop. The process_next_command function parses the next
  * command and hands off execution to individual handler functions.
+ *
+ * Each record is a queue_record_t header followed by the null terminated
+ * command. A record never wraps around the end of the arena; if it does not
+ * fit at the end, a wrap marker is left and the record starts at offset 0.
+ * The arena is allocated by init_queue() from the SRAM that is free at boot.
+ *
+ * Command sources receive lines straight into the arena: queue_reserve()
+ * returns the space where the next record's command will go, and
+ * queue_commit() turns it into a record in place. A rejected line is rolled
+ * back by simply not committing it. One source holds the reservation at a time.
  */
 
 #ifndef __QUEUE_H__
@@ -15,27 +25,50 @@
 #include "types.h"
 #include "config.h"
 
-extern uint8_t cmd_queue_index_r, // Ring buffer read position
-    cmd_queue_index_w;            // Ring buffer write position
-extern char command_queue[MAX_QUEUE_LEN][MAX_CMD_SIZE];
-extern bool queue_full;
+typedef struct {
+    uint16_t len;   // Length of the command, excluding the terminator
+} queue_record_t;
+
+// Record length that tells the reader to continue from the start of the arena
+#define QUEUE_WRAP_MARKER 0xFFFF
+
+// Bytes used by a record holding a command of len chars
+#define QUEUE_RECORD_SIZE(len) (int)(sizeof(queue_record_t) + (len) + 1)
+
+extern char *command_queue;     // The arena
+extern int queue_size;          // Size of the arena in bytes
+extern int queue_max_cmd_size;  // Longest command that fits in the arena, including terminator
+extern int queue_head,          // Offset of the oldest record
+    queue_tail;                 // Offset where the next record will be written
+extern int queue_count;         // Number of records in the queue
+extern int queue_reserved;      // Offset of the reserved record, -1 if none
+extern const void *queue_reserved_owner; // Source holding the reservation
 extern long this_linenum; // The linenum of the command being currently parsed
 extern long last_linenum; // the last linenum that was parsed
 extern long idle_linenum; // the last linenum where an idle was printed
 extern long long int commands_processed;
+extern bool flow_control_enabled;  // Report free queue capacity in acks and status lines
 
 int init_queue();
 
 /**
- * Get current number of commands in queue from read and write indices and full flag
+ * Get current number of commands in queue
  */
 inline int queue_length() {
-    if(queue_full) {
-        return MAX_QUEUE_LEN;
-    } else {
-        // we want modulo, not remainder
-        return (cmd_queue_index_w - cmd_queue_index_r + MAX_QUEUE_LEN) % MAX_QUEUE_LEN;
+    return queue_count;
+}
+
+/**
+ * Get the number of bytes used by records in the queue, including wasted space before a wrap
+ */
+inline int queue_used_bytes() {
+    if (!queue_count) {
+        return 0;
+    }
+    if (queue_tail > queue_head) {
+        return queue_tail - queue_head;
     }
+    return queue_size - queue_head + queue_tail;
 }
 
 /**
@@ -43,34 +76,76 @@ inline int queue_length() {
  */
 inline void queue_clear()
 {
-    cmd_queue_index_r = cmd_queue_index_w;
-    queue_full = false;
+    queue_head = queue_tail = 0;
+    queue_count = 0;
+    queue_reserved = -1;
 }
 
 /**
- * Increment the command queue read index
+ * Get the offset that a record of len chars would be written at, or -1 if it does not fit
  */
-inline void queue_advance_read() {
-    if( cmd_queue_index_w == cmd_queue_index_r){
-        if(!queue_full){
-            // If the queue was previously empty, don't do anything
-            return;
-        }
-        queue_full = false;
-    }
-    cmd_queue_index_r = (cmd_queue_index_r+1) % MAX_QUEUE_LEN;
+int queue_write_offset(int len);
+
+/**
+ * Whether a command of len chars would fit in the queue
+ */
+inline bool queue_has_room(int len) {
+    return queue_write_offset(len) >= 0;
 }
 
 /**
- * Increment the command queue write index
+ * Whether the queue has room for a command of the maximum length,
+ * command sources should stop reading when it does not.
  */
-inline void queue_advance_write() {
-    cmd_queue_index_w = (cmd_queue_index_w+1) % MAX_QUEUE_LEN;
-    if(cmd_queue_index_w == cmd_queue_index_r){
-        queue_full = true;
-    }
+inline bool queue_accepting() {
+    return queue_has_room(queue_max_cmd_size - 1);
 }
 
+/**
+ * Get the number of commands of the maximum length that would fit in the queue
+ */
+int queue_free_slots();
+
+/**
+ * Get the number of arena bytes available for new records. A command of len
+ * chars uses QUEUE_RECORD_SIZE(len) bytes, rounded up to an even number.
+ */
+int queue_free_bytes();
+
+/**
+ * Get the oldest command in the queue, or NULL if the queue is empty
+ */
+char *queue_peek();
+
+/**
+ * Remove the oldest command from the queue
+ */
+void queue_advance_read();
+
+/**
+ * Reserve space for a command of up to len chars (excluding terminator) to be
+ * written in place, sources reading lines of unknown length reserve
+ * queue_max_cmd_size - 1. Reserving again with the same owner returns the
+ * same space. Returns NULL if there is no room, or if another owner holds
+ * the reservation.
+ */
+char *queue_reserve(const void *owner, int len);
+
+/**
+ * Commit the null terminated command of len chars written to the reservation
+ */
+bool queue_commit(const void *owner, int len);
+
+/**
+ * Give up the reservation without committing it
+ */
+void queue_release(const void *owner);
+
+/**
+ * Push a complete command onto the end of the queue, reserving only the space it needs.
+ * Fails while another source holds the reservation, as it is partway through receiving
+ * the line that comes next.
+ */
 bool enqueue_command(const char* cmd);
 
 void debug_queue(const char* debug_prefix);
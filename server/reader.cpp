@@ -0,0 +1,352 @@
+#include "reader.h"
+#include "serial.h"
+#include "macros.h"
+#include "frame.h"
+#include "queue.h"
+#include "gcode.h"
+
+// Characters that interrupt a run of regular characters
+#define IS_READER_SPECIAL(a) (IS_EOL(a) || (a == ESCAPE_PREFIX) || (a == COMMENT_PREFIX) || (a == FRAME_DELIMITER))
+
+// Field that holds a streamable payload
+#define STREAM_FIELD 'V'
+
+CommandReader::CommandReader(read_chunk_fn read_chunk, uint8_t features)
+    : line(NULL), line_len(0), checksum(0), checksum_expected(-1), streamed(false), stream_len(0),
+      stream_bad_tail(false), hold_streaming(false), read_chunk(read_chunk), chunk_start(0), chunk_end(0),
+      line_size(0), count(0), features(features), comment_mode(false), escape_mode(false),
+      frame_mode(false), line_ready(false)
+{
+    start_line();
+}
+
+bool CommandReader::next_line()
+{
+    if (!line)
+    {
+        line = queue_reserve(this, queue_max_cmd_size - 1);
+        if (!line)
+            return false;
+        line_size = queue_max_cmd_size;
+    }
+    if (stream_stalled)
+    {
+        // Pixels can only be written once the commands before this one have been processed
+        if (queue_length())
+            return false;
+        stream_stalled = false;
+        start_stream();
+    }
+    while (true)
+    {
+        if (chunk_start >= chunk_end)
+        {
+            chunk_start = 0;
+            chunk_end = read_chunk(chunk, INGEST_CHUNK_SIZE);
+            if (chunk_end <= 0)
+            {
+                chunk_end = 0;
+                if (!count)
+                {
+                    // Nothing stored, let other sources use the reservation
+                    queue_release(this);
+                    line = NULL;
+                }
+                return false;
+            }
+        }
+        chunk_start += consume(chunk + chunk_start, chunk_end - chunk_start);
+        if (line_ready)
+        {
+            line_ready = false;
+            return true;
+        }
+        if (stream_stalled)
+            return false;
+    }
+}
+
+bool CommandReader::commit()
+{
+    if (!line || !line_len)
+        return false;
+    bool committed = queue_commit(this, line_len);
+    line = NULL;
+    line_len = 0;
+    return committed;
+}
+
+void CommandReader::discard()
+{
+    queue_release(this);
+    line = NULL;
+    line_len = 0;
+}
+
+void CommandReader::flush()
+{
+    queue_release(this);
+    line = NULL;
+    line_len = 0;
+    chunk_start = chunk_end = 0;
+    count = 0;
+    comment_mode = escape_mode = frame_mode = line_ready = false;
+    start_line();
+}
+
+/**
+ * Append text to the line, keeping track of the checksum as it is copied.
+ * Characters beyond the max length are ignored, the line is still completed when EOL is reached.
+ */
+void CommandReader::append(const char *data, int len)
+{
+    int room = line_size - 1 - count;
+    if (len > room)
+        len = room;
+    char *out = line + count;
+    for (int i = 0; i < len; i++)
+    {
+        const char c = data[i];
+        if (c == CHECKSUM_PREFIX)
+        {
+            checksum_before = line_checksum;
+            checksum_pos = count + i;
+        }
+        line_checksum ^= c;
+        out[i] = c;
+    }
+    if (len > 0)
+        count += len;
+}
+
+/**
+ * Append bytes to the line as they are, for binary frames
+ */
+void CommandReader::append_raw(const char *data, int len)
+{
+    int room = line_size - 1 - count;
+    if (len > room)
+        len = room;
+    if (len <= 0)
+        return;
+    memcpy(line + count, data, len);
+    count += len;
+}
+
+void CommandReader::finish_line()
+{
+    checksum = line_checksum;
+    checksum_expected = -1;
+    if (checksum_pos >= 0)
+    {
+        // Cut the checksum field and the spaces before it off the line
+        checksum = checksum_before;
+        line[count] = STRING_TERMINATOR;
+        checksum_expected = strtol(line + checksum_pos + 1, NULL, 16);
+        count = checksum_pos;
+        while (count && IS_SPACE(line[count - 1]))
+            count--;
+    }
+    line[count] = STRING_TERMINATOR;
+    line_len = count;
+    count = 0;
+    line_ready = true;
+
+    streamed = line_streamed;
+    stream_len = line_stream_len;
+    stream_bad_tail = line_stream_bad_tail;
+    start_line();
+}
+
+/**
+ * Reset the per-line checksum and streaming state
+ */
+void CommandReader::start_line()
+{
+    line_checksum = 0;
+    checksum_pos = -1;
+    stream_watch = STREAM_PIXEL_PAYLOADS && (features & READER_STREAMING);
+    stream_stalled = false;
+    stream_mode = false;
+    stream_group_len = 0;
+    line_streamed = false;
+    line_stream_len = 0;
+    line_stream_bad_tail = false;
+}
+
+/**
+ * Start streaming the payload if the line so far is the head of a streamable command
+ */
+bool CommandReader::start_stream()
+{
+    line[count] = STRING_TERMINATOR;
+    if (!stream_M260X_begin(line))
+        return false;
+    stream_mode = true;
+    line_streamed = true;
+    return true;
+}
+
+/**
+ * Decode payload characters into the panel in groups of 4
+ */
+void CommandReader::stream_payload(const char *data, int len)
+{
+    line_stream_len += len;
+    for (int i = 0; i < len; i++)
+        line_checksum ^= data[i];
+
+    // Complete a group that was split across chunks
+    while (stream_group_len && len)
+    {
+        stream_group[stream_group_len++] = *data++;
+        len--;
+        if (stream_group_len == 4)
+        {
+            stream_M260X_pixels(stream_group, 1);
+            stream_group_len = 0;
+        }
+    }
+
+    int groups = len / 4;
+    stream_M260X_pixels(data, groups);
+    data += groups * 4;
+    len -= groups * 4;
+
+    while (len--)
+        stream_group[stream_group_len++] = *data++;
+}
+
+/**
+ * Consume bytes from data until a line is complete or data is exhausted.
+ * Return the number of bytes consumed.
+ */
+int CommandReader::consume(const char *data, int len)
+{
+    int i = 0;
+    while (i < len)
+    {
+        if (frame_mode)
+        {
+            // Frames are stored raw up to the closing delimiter, oversized frames fail their crc
+            const char *end = (const char *)memchr(data + i, FRAME_DELIMITER, len - i);
+            int run = end ? (int)(end - (data + i)) : (len - i);
+            append_raw(data + i, run);
+            i += run;
+            if (!end)
+                break;
+            i++;
+            if (count <= 1)
+                continue; // Empty frame, treat the delimiter as the start of the next frame
+            frame_mode = false;
+            finish_line();
+            return i;
+        }
+
+        if (stream_mode)
+        {
+            int start = i;
+            while ((i < len) && IS_BASE64(data[i]))
+                i++;
+            stream_payload(data + start, i - start);
+            if (i >= len)
+                break;
+            // The payload ends at the first character that is not base64, which is processed normally
+            stream_mode = false;
+            if (!IS_SPACE(data[i]) && (data[i] != CHECKSUM_PREFIX))
+                line_stream_bad_tail = true;
+            continue;
+        }
+
+        if (escape_mode)
+        {
+            // Copy the escaped character over, whatever it is
+            escape_mode = false;
+            if (!comment_mode)
+                append(data + i, 1);
+            i++;
+            continue;
+        }
+
+        // Block scan to the next special character
+        int start = i;
+        if (comment_mode)
+        {
+            while ((i < len) && !IS_EOL(data[i]) && (data[i] != ESCAPE_PREFIX))
+                i++;
+        }
+        else
+        {
+            if (!count)
+            {
+                while ((i < len) && IS_SPACE(data[i]) && !IS_EOL(data[i]))
+                    i++; // Skip leading spaces
+                start = i;
+            }
+            if (stream_watch)
+            {
+                while ((i < len) && !IS_READER_SPECIAL(data[i]) && (data[i] != STREAM_FIELD))
+                    i++;
+            }
+            else
+            {
+                while ((i < len) && !IS_READER_SPECIAL(data[i]))
+                    i++;
+            }
+            append(data + start, i - start);
+        }
+        if (i >= len)
+            break;
+
+        const char c = data[i++];
+        if (IS_EOL(c))
+        {
+            comment_mode = false; // end of line == end of comment
+            if (!count)
+                continue; // Skip empty lines
+            finish_line();
+            return i;
+        }
+        else if (c == ESCAPE_PREFIX)
+        {
+            escape_mode = true;
+        }
+        else if (c == COMMENT_PREFIX)
+        {
+            comment_mode = true;
+        }
+        else if (c == STREAM_FIELD)
+        {
+            append(&c, 1);
+            if ((count >= 2) && IS_SPACE(line[count - 2]) && !hold_streaming)
+            {
+                // Only the first V field is considered
+                stream_watch = false;
+                line[count] = STRING_TERMINATOR;
+                if (stream_M260X_begin(line))
+                {
+                    if (queue_length())
+                    {
+                        stream_stalled = true;
+                        return i;
+                    }
+                    stream_mode = true;
+                    line_streamed = true;
+                }
+            }
+        }
+        else if ((features & READER_FRAMES) && binary_frames_enabled)
+        {
+            // A frame delimiter discards any partial line
+            start_line();
+            frame_mode = true;
+            line[0] = FRAME_PREFIX;
+            count = 1;
+        }
+        else
+        {
+            append(&c, 1);
+        }
+    }
+    return i;
+}
@@ -0,0 +1,108 @@
+/**
+ * Command Reader
+ * Assembles command lines from a byte source that is read in bulk.
+ *
+ * Each source (serial, EEPROM, a test stream) provides a function that copies
+ * whatever it has buffered into a chunk. Line ends, escapes, comments and
+ * binary frames are then found by scanning the chunk in blocks instead of
+ * calling available() / read() and branching once per byte.
+ *
+ * Lines are assembled in place in the command queue's reservation, so a
+ * completed line is either committed to the queue or discarded without a copy.
+ *
+ * The XOR checksum of each line is worked out as it is copied into the line,
+ * and the checksum field is cut off the completed line, so validating it is
+ * O(1) and nothing after the reader has to look for the checksum again.
+ *
+ * With READER_STREAMING, once the head of an M2600 / M2601 line has been
+ * received up to its V field, the payload is decoded into the panel 4
+ * characters at a time as it arrives instead of being stored. The stored
+ * line keeps everything but the payload, and the completed line is flagged
+ * as streamed so it can be validated and answered without being queued.
+ */
+
+#ifndef __READER_H__
+#define __READER_H__
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * Copy up to len bytes that are immediately available from a source into buffer.
+ * Return the number of bytes copied, 0 if nothing is available.
+ */
+typedef int (*read_chunk_fn)(char *buffer, int len);
+
+// Reader features
+#define READER_FRAMES 0x01      // The source may carry binary frames
+#define READER_STREAMING 0x02   // Pixel payloads may be decoded as they arrive
+
+class CommandReader
+{
+  public:
+    char *line;         // The most recently completed line or frame, null terminated, NULL if not reserved
+    int line_len;       // Length of the completed line
+    uint8_t checksum;   // XOR of the completed line's characters before the checksum field, including streamed ones
+    int checksum_expected;    // Value of the completed line's checksum field, -1 if it did not have one
+    bool streamed;      // The completed line's payload was decoded while it was received
+    int stream_len;     // Number of payload characters that were streamed
+    bool stream_bad_tail;     // The payload was followed by something other than a space or checksum
+    bool hold_streaming;      // Store payloads instead of streaming them, e.g. while lines may arrive out of order
+
+    CommandReader(read_chunk_fn read_chunk, uint8_t features);
+
+    // Read chunks from the source until a line is complete.
+    // Returns false if the source runs out of bytes first, the partial line is kept.
+    // Returns false without reading if queue space cannot be reserved.
+    bool next_line();
+
+    // Add the completed line to the command queue
+    bool commit();
+
+    // Drop the completed line and give up its queue space
+    void discard();
+
+    // Discard the partial line and any bytes that have been read but not consumed
+    void flush();
+
+    // The number of characters in the partial line
+    int partial_len() { return count; }
+
+  private:
+    read_chunk_fn read_chunk;
+    char chunk[INGEST_CHUNK_SIZE];
+    int chunk_start;    // Index of the first unconsumed byte in chunk
+    int chunk_end;      // Number of bytes in chunk
+    int line_size;
+    int count;          // The index of the character in the line being read
+    uint8_t features;
+    bool comment_mode;
+    bool escape_mode;   // The previous character was an escape
+    bool frame_mode;    // The bytes being read belong to a binary frame
+    bool line_ready;
+
+    // Checksum state of the line being read
+    uint8_t line_checksum;    // XOR of the characters so far
+    uint8_t checksum_before;  // XOR of the characters before the last checksum prefix
+    int checksum_pos;   // Index of the last checksum prefix in the line, -1 if none
+
+    // Streaming state of the line being read
+    bool stream_watch;  // Look for the V field of a streamable command
+    bool stream_stalled;// Waiting for the queue to drain before streaming
+    bool stream_mode;   // The bytes being read belong to a streamed payload
+    char stream_group[4];
+    int stream_group_len;
+    bool line_streamed;
+    int line_stream_len;
+    bool line_stream_bad_tail;
+
+    int consume(const char *data, int len);
+    void append(const char *data, int len);
+    void append_raw(const char *data, int len);
+    void finish_line();
+    void start_line();
+    bool start_stream();
+    void stream_payload(const char *data, int len);
+};
+
+#endif /* __READER_H__ */
@@ -0,0 +1,180 @@
+#include "resend.h"
+#include "queue.h"
+#include "serial.h"
+#include "debug.h"
+#include "macros.h"
+#include "trace.h"
+
+typedef struct {
+    long linenum;
+    int offset;     // Offset of the null terminated line in the window
+} resend_entry_t;
+
+char *resend_window = NULL;
+int resend_window_size = 0;
+int resend_window_used = 0;     // Lines are appended, the space is reused once the window empties
+// At least one entry so that the window code builds without it, the window is never allocated then
+resend_entry_t resend_entries[MAX(1, RESEND_WINDOW_LINES)];
+int resend_count = 0;           // Number of retained lines
+long resend_nak_next = -1;      // Lines before this have been NAKed or retained, -1 if no lines are missing
+bool resend_rewound = false;     // Skip lines until the line after the last one accepted arrives
+
+int init_resend() {
+    #if RESEND_WINDOW_LINES
+        if (!resend_window) {
+            // The window is optional, fall back to go-back-N rather than starve the command queue
+            if (getFreeSram() - QUEUE_SRAM_RESERVE - QUEUE_MIN_SIZE < RESEND_WINDOW_SIZE) {
+                return 0;
+            }
+            resend_window = (char *)malloc(RESEND_WINDOW_SIZE);
+            if (!resend_window) {
+                SNPRINTF_MSG_PSTR("malloc failed for resend window: %d bytes", RESEND_WINDOW_SIZE);
+                return 2;
+            }
+            resend_window_size = RESEND_WINDOW_SIZE;
+        }
+    #endif
+    resend_clear();
+    return 0;
+}
+
+bool resend_active() {
+    return resend_nak_next >= 0;
+}
+
+void resend_clear() {
+    resend_count = 0;
+    resend_window_used = 0;
+    resend_nak_next = -1;
+    resend_rewound = false;
+}
+
+void resend_rewind() {
+    resend_clear();
+    resend_rewound = true;
+}
+
+bool resend_rewinding() {
+    return resend_rewound;
+}
+
+void resend_nak(long linenum) {
+    trace_event(TRACE_RESEND, linenum, 'L');
+    SER_SNPRINTF_MSG_PSTR("RL %ld", linenum);
+}
+
+inline resend_entry_t *resend_find(long linenum) {
+    for (int i = 0; i < resend_count; i++) {
+        if (resend_entries[i].linenum == linenum) {
+            return &resend_entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Start keeping track of missing lines, from the line after the last one accepted
+ */
+inline void resend_start() {
+    if (!resend_active()) {
+        resend_nak_next = last_linenum + 1;
+    }
+}
+
+void resend_line_failed(long linenum) {
+    resend_start();
+    if ((linenum <= last_linenum) || (linenum - last_linenum > RESEND_WINDOW_LINES) || resend_find(linenum)) {
+        // The line number can't be right, hosts send lines in order so assume it was the next new line
+        linenum = resend_nak_next;
+    }
+    if (linenum < resend_nak_next) {
+        // A line that was already missing
+        resend_nak(linenum);
+        return;
+    }
+    for (; resend_nak_next <= linenum; resend_nak_next++) {
+        if (!resend_find(resend_nak_next)) {
+            resend_nak(resend_nak_next);
+        }
+    }
+}
+
+int resend_check_line(long linenum) {
+    if (linenum < 0) {
+        return RESEND_ACCEPT;
+    }
+    if (resend_rewound) {
+        if (linenum != last_linenum + 1) {
+            return RESEND_SKIP;
+        }
+        resend_rewound = false;
+        return RESEND_ACCEPT;
+    }
+    if (!resend_active()) {
+        if ((linenum == last_linenum + 1) || !(REQUIRE_CONSECUTIVE_LINENUM || RESEND_WINDOW_LINES)) {
+            return RESEND_ACCEPT;
+        }
+        if (linenum <= last_linenum) {
+            return RESEND_DROP;
+        }
+        resend_start();
+    }
+    if ((linenum <= last_linenum) || resend_find(linenum)) {
+        return RESEND_DROP;
+    }
+    if (linenum == last_linenum + 1) {
+        return RESEND_ACCEPT;
+    }
+    if (!resend_window_size || (linenum - last_linenum > RESEND_WINDOW_LINES)) {
+        return RESEND_FLUSH;
+    }
+    // The lines between the last one NAKed and this one are missing
+    for (; resend_nak_next < linenum; resend_nak_next++) {
+        if (!resend_find(resend_nak_next)) {
+            resend_nak(resend_nak_next);
+        }
+    }
+    if (resend_nak_next == linenum) {
+        resend_nak_next++;
+    }
+    return RESEND_RETAIN;
+}
+
+bool resend_retain(long linenum, const char *line, int len) {
+    #if RESEND_WINDOW_LINES
+        if ((resend_count >= RESEND_WINDOW_LINES) || (resend_window_used + len + 1 > resend_window_size)) {
+            return false;
+        }
+        resend_entries[resend_count].linenum = linenum;
+        resend_entries[resend_count].offset = resend_window_used;
+        memcpy(resend_window + resend_window_used, line, len + 1);
+        resend_window_used += len + 1;
+        resend_count++;
+        return true;
+    #else
+        return false;
+    #endif
+}
+
+void resend_release() {
+    if (!resend_active()) {
+        return;
+    }
+    resend_entry_t *entry;
+    while ((entry = resend_find(last_linenum + 1))) {
+        if (!enqueue_command(resend_window + entry->offset)) {
+            // No room, try again once the queue has drained
+            return;
+        }
+        last_linenum++;
+        trace_event(TRACE_ENQUEUED, last_linenum, queue_length());
+        *entry = resend_entries[--resend_count];
+    }
+    if (!resend_count) {
+        resend_window_used = 0;
+        if (resend_nak_next <= last_linenum + 1) {
+            // Nothing is missing
+            resend_nak_next = -1;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * Selective Resend
+ * Keeps numbered serial lines that arrive after a missing line, so that only
+ * the missing lines have to be resent.
+ *
+ * A line is missing when it fails validation, or when a line arrives with a
+ * later number than the next one expected. Each missing line is NAKed once
+ * with "RL <N>", and the valid lines that follow it are retained in a window
+ * until the missing lines arrive, then they are queued in order. Lines that
+ * arrive twice are dropped. If the window fills up, or a line arrives too far
+ * ahead, the window is dropped and everything is resent from the first
+ * missing line with "RS <N>" (go-back-N), which is also what happens if the
+ * window could not be allocated. After "RS <N>", lines are skipped until line N
+ * arrives, since the host sends everything after it again.
+ *
+ * Streamed payloads are written to the panel as they arrive, so a streamed
+ * line that arrives after a missing line cannot be retained; it is NAKed and
+ * rewritten in order when it is resent.
+ *
+ * Selective resend relies on the host numbering lines consecutively.
+ */
+
+#ifndef __RESEND_H__
+#define __RESEND_H__
+
+#include <Arduino.h>
+#include "config.h"
+
+// What to do with a valid line, returned by resend_check_line()
+#define RESEND_ACCEPT 0     // Next line in sequence, queue it
+#define RESEND_RETAIN 1     // Arrived after a missing line, keep it in the window
+#define RESEND_DROP 2       // Already received
+#define RESEND_FLUSH 3      // Cannot be retained, resend everything from the first missing line
+#define RESEND_SKIP 4       // Sent before everything was requested again, it will be resent
+
+extern int resend_window_size;  // Size of the window in bytes, 0 if it could not be allocated
+
+/**
+ * Allocate the window, if there is enough SRAM left for it and the command queue
+ * Return error code
+ */
+int init_resend();
+
+/**
+ * Whether lines are missing or retained
+ */
+bool resend_active();
+
+/**
+ * Drop any retained lines and forget about missing lines
+ */
+void resend_clear();
+
+/**
+ * Everything from the line after the last one accepted is requested again
+ */
+void resend_rewind();
+
+/**
+ * Whether lines are being skipped until the line after the last one accepted arrives
+ */
+bool resend_rewinding();
+
+/**
+ * A line failed validation, NAK the line it most likely was.
+ * linenum is the line number it was received with, which may be corrupt, -1 if none.
+ */
+void resend_line_failed(long linenum);
+
+/**
+ * Decide what to do with a valid line, NAK any lines that it shows are missing
+ */
+int resend_check_line(long linenum);
+
+/**
+ * Keep a line that arrived after a missing line.
+ * Return false if there is no room in the window.
+ */
+bool resend_retain(long linenum, const char *line, int len);
+
+/**
+ * Queue retained lines that are next in sequence, as far as there is room
+ */
+void resend_release();
+
+/**
+ * Request a single line again
+ */
+void resend_nak(long linenum);
+
+#endif /* __RESEND_H__ */
@@ -17,3 +17,14 @@ void init_serial() {
         SERIAL_OBJ_IN.begin(SERIAL_BAUD);
     }
 }
+
+int serial_read_chunk(char *buffer, int len) {
+    int available = SERIAL_OBJ_IN.available();
+    if (available <= 0) {
+        return 0;
+    }
+    if (available < len) {
+        len = available;
+    }
+    return SERIAL_OBJ_IN.readBytes(buffer, len);
+}
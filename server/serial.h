@@ -5,7 +5,7 @@
 
 // Length of various buffer
 #define BUFFLEN_MSG 300
-#define BUFFLEN_ERR 16
+#define BUFFLEN_ERR 32
 #define BUFFLEN_FMT 128
 
 // Definition of special serial control characters
@@ -14,6 +14,10 @@
 #define LINENUM_PREFIX 'N'
 #define CHECKSUM_PREFIX '*'
 #define STRING_TERMINATOR '\0'
+// Delimits binary frames on the wire, see frame.h
+#define FRAME_DELIMITER '\0'
+// Marks a queued command as a binary frame instead of GCode
+#define FRAME_PREFIX '\x02'
 
 // Serial out Buffer
 extern char msg_buffer[BUFFLEN_MSG];
@@ -94,4 +98,7 @@ extern char err_buffer[BUFFLEN_ERR];
 
 void init_serial();
 
+// Copy whatever is buffered in SERIAL_OBJ_IN, up to len bytes
+int serial_read_chunk(char *buffer, int len);
+
 #endif /* __SERIAL_H__ */
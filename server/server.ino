@@ -16,6 +16,13 @@
 #include "macros.h"
 #include "queue.h"
 #include "eeprom.h"
+#include "frame.h"
+#include "reader.h"
+#include "resend.h"
+#include "jitter.h"
+#include "output.h"
+#include "latency.h"
+#include "trace.h"
 
 // The linenum of the last command parsed
 long last_parsed_linenum;
@@ -36,11 +43,30 @@ long last_parsed_linenum;
     int last_queue_len = 0;
 #endif
 
+/**
+ * Command Readers
+ * Each command source has its own chunked reader, lines are received straight into the queue
+ */
+CommandReader eeprom_reader(eeprom_code_read_chunk, 0);
+CommandReader serial_reader(serial_read_chunk, READER_FRAMES | READER_STREAMING);
+
+// Ticks spent reading the partial serial line so far, see LATENCY_INGEST
+uint32_t serial_ingest_ticks = 0;
+
+// Whether the queue wasn't accepting lines last loop, see TRACE_QUEUE_FULL
+bool queue_was_full = false;
+
 void sw_reset(){
-    #if defined(__MK20DX128__) || defined(__MK20DX256__)
+    #if defined(__MK20DX128__) || defined(__MK20DX256__) || defined(HOST_BUILD)
         init_clock();
+        eeprom_reader.flush();
+        serial_reader.flush();
+        serial_ingest_ticks = 0;
         init_queue();
+        resend_clear();
+        jitter_clear();
         reinit_panels();
+        reset_latency();
     #else
         // Restarts program from beginning but does not reset the peripherals and registers
         asm volatile ("  jmp 0");
@@ -53,71 +79,19 @@ void sw_reset(){
 void get_eeprom_commands() {
     const char * debug_prefix = "GEC";
 
-    // The current buffer being used by get_eeprom_commands
-    static char eeprom_line_buffer[MAX_CMD_SIZE];
-    static bool eeprom_comment_mode = false;
-
-    // The index of the character in the line being read from eeprom.
-    static int eeprom_count = 0;
-
-    // #if DEBUG_EEPROM
-    //     SER_SNPRINTF_COMMENT_PSTR("%s: Calling Get EEPROM Commands", debug_prefix);
-    //     SER_SNPRINTF_COMMENT_PSTR("%s: --> eeprom_count: %d", debug_prefix, eeprom_count);
-    // #endif
-
-    while (eeprom_code_available() && (queue_length() < MAX_QUEUE_LEN)) {
-        char eeprom_char = eeprom_code_read();
-        if (IS_EOL(eeprom_char))
-        {
-            #if DEBUG_EEPROM
-                SER_SNPRINTF_COMMENT_PSTR("%s: eeprom char is EOL", debug_prefix);
-                debug_queue(debug_prefix);
-            #endif
-            eeprom_comment_mode = false; // end of line == end of comment
-
-            if (!eeprom_count)
-                continue; // Skip empty lines
-
-            eeprom_line_buffer[eeprom_count] = 0; // Terminate string
-            eeprom_count = 0;                     // Reset buffer
-
-            char *command = eeprom_line_buffer;
-
-            while (IS_SPACE(*command))
-                command++; // Skip leading spaces
+    while (queue_accepting() && eeprom_reader.next_line()) {
+        #if DEBUG_EEPROM
+            SER_SNPRINTF_COMMENT_PSTR("%s: eeprom line complete", debug_prefix);
+            debug_queue(debug_prefix);
+        #endif
 
-            this_linenum = -1;
-            enqueue_command(command);
+        this_linenum = -1;
+        eeprom_reader.commit();
+    }
 
-        }
-        else if (eeprom_count >= MAX_CMD_SIZE - 1)
-        {
-            // if (DEBUG_EEPROM) { SER_SNPRINTF_COMMENT_PSTR("%s: serial count %d is larger than MAX_CMD_SIZE: %d, ignore", debug_prefix, eeprom_count, MAX_CMD_SIZE); }
-            // Keep fetching, but ignore normal characters beyond the max length
-            // The command will be injected when EOL is reached
-        }
-        else if (eeprom_char == ESCAPE_PREFIX)
-        { // Handle escapes
-            // if (DEBUG_EEPROM) { SER_SNPRINT_COMMENT_PSTR("GEC: serial char is escape"); }
-            if (eeprom_code_available())
-            {
-                // if we have one more character, copy it over
-                eeprom_char = eeprom_code_read();
-                if (!eeprom_comment_mode)
-                    eeprom_line_buffer[eeprom_count++] = eeprom_char;
-            }
-            // otherwise do nothing
-        }
-        else
-        {
-            // if (DEBUG_QUEUE) { SER_SNPRINT_COMMENT_PSTR("GEC: serial char is regular"); }
-            // it's not a newline, carriage return or escape char
-            if (eeprom_char == COMMENT_PREFIX)
-                eeprom_comment_mode = true;
-            // So we can write it to the eeprom_line_buffer
-            if (!eeprom_comment_mode)
-                eeprom_line_buffer[eeprom_count++] = eeprom_char;
-        }
+    if (!eeprom_code_available()) {
+        // An unterminated line at the end of the code is never enqueued
+        eeprom_reader.flush();
     }
 }
 
@@ -127,7 +101,8 @@ void get_eeprom_commands() {
 void flush_serial_resend() {
     const char *debug_prefix = "FLU";
 
-    SER_SNPRINTF_MSG_PSTR("RS %d", last_linenum + 1);
+    trace_event(TRACE_RESEND, last_linenum + 1, 'S');
+    SER_SNPRINTF_MSG_PSTR("RS %ld", last_linenum + 1);
 
     #if DEBUG
         SER_SNPRINTF_COMMENT_PSTR(
@@ -138,6 +113,7 @@ void flush_serial_resend() {
 
     delay(FAIL_WAIT_PERIOD);
 
+    serial_reader.flush();
     while(SERIAL_OBJ_IN.available() > 0){
         SERIAL_OBJ_IN.read();
     }
@@ -149,67 +125,52 @@ void flush_serial_resend() {
 
 /**
  * Validate Checksum (*) and Line Number (N) Parameters if they exist in the command
+ * checksum is the XOR of the characters received before the checksum field, worked out by the reader,
+ * expected_checksum is the value of the checksum field, -1 if there was none.
+ * Only the start of the line is read, the checksum field has already been cut off.
  * Return error code
  */
-int validate_serial_special_fields(char *command) {
+int validate_serial_special_fields(char *command, uint8_t checksum, int expected_checksum) {
     const char* debug_prefix = "VSF";
-    char *npos = (*command == LINENUM_PREFIX) ? command : NULL; // Require the N parameter to start the line
+    bool M110 = false;
     #if DEBUG_QUEUE
         SER_SNPRINTF_COMMENT_PSTR(
-            "%s: CMD: %s, NPOS: 0x%08x",
-            debug_prefix, command, npos
+            "%s: CMD: %s, checksum: %02X / %02X",
+            debug_prefix, command, checksum, expected_checksum
         );
         debug_queue(debug_prefix);
     #endif
-    if (npos)
+    // Require the N parameter to start the line
+    if (*command == LINENUM_PREFIX)
     {
-        bool M110 = strstr_P(command, PSTR("M110")) != NULL;
-
-        #if DEBUG_QUEUE
-            SER_SNPRINTF_COMMENT_PSTR(
-                "%s: M110: %d, last_linenum: %d",
-                debug_prefix, M110, last_linenum
-            );
-        #endif
+        char *p;
+        this_linenum = strtol(command + 1, &p, 10);
+        while (IS_SPACE(*p))
+            p++;
 
+        // M110 gives this line the number in its own N parameter
+        M110 = (strncmp_P(p, PSTR("M110"), 4) == 0) && !NUMERIC(p[4]);
         if (M110)
         {
-            char *n2pos = strchr(command + 4, 'N');
+            char *n2pos = strchr(p + 4, LINENUM_PREFIX);
             if (n2pos)
-                npos = n2pos;
+                this_linenum = strtol(n2pos + 1, NULL, 10);
         }
 
-        this_linenum = strtol(npos + 1, NULL, 10);
-
         #if DEBUG_QUEUE
             SER_SNPRINTF_COMMENT_PSTR(
-                "%s: this_linenum: %d",
-                debug_prefix, this_linenum
+                "%s: this_linenum: %d, M110: %d, last_linenum: %d",
+                debug_prefix, this_linenum, M110, last_linenum
             );
         #endif
 
-        // TODO: If this_linenum == last_linenum + 2, resent last_linenum + 1
-        #if REQUIRE_CONSECUTIVE_LINENUM
-            if (this_linenum != last_linenum + 1 && !M110)
-            {
-                SNPRINTF_MSG_PSTR("Line numbers not sequential. Current: %d, Previous: %d", this_linenum, last_linenum);
-                #if REQUIRE_CONSECUTIVE_LINENUM
-                this_linenum = last_linenum + 1;
-                #endif
-                return 10;
-            }
-        #endif
+        // Sequence is checked once the line is known to be valid, see resend_check_line()
     }
-    char *apos = strrchr(command, CHECKSUM_PREFIX);
-    if (apos)
+    if (expected_checksum >= 0)
     {
-        uint8_t checksum = 0, count = uint8_t(apos - command);
-        while (count)
-            checksum ^= command[--count];
-        long expected_checksum = strtol(apos + 1, NULL, 10);
         if (expected_checksum != checksum)
         {
-            SNPRINTF_MSG_PSTR("Checksum mismatch: Client expected: %d, Server calculated: %d", expected_checksum, checksum);
+            SNPRINTF_MSG_PSTR("Checksum mismatch: Client expected: %02X, Server calculated: %02X", expected_checksum, checksum);
             return 19;
         }
     }
@@ -220,8 +181,11 @@ int validate_serial_special_fields(char *command) {
         }
     #endif
 
-    if(this_linenum != -1){
-        last_linenum = this_linenum;
+    if (M110)
+    {
+        // Numbering restarts from this line, nothing before it can be missing
+        resend_clear();
+        last_linenum = this_linenum - 1;
     }
     return 0;
 }
@@ -234,113 +198,173 @@ void get_serial_commands()
 {
     const char * debug_prefix = "GSC";
 
-    // The current buffer being used by get_serial_commands
-    static char serial_line_buffer[MAX_CMD_SIZE];
-    static bool serial_comment_mode = false;
-
-    // The index of the character in the line being read from serial.
-    static int serial_count = 0;
-
     #if DEBUG_SERIAL
         if(SERIAL_OBJ_IN.available() > 0){
             SER_SNPRINTF_COMMENT_PSTR(
-                "%s: Serial available, serial_count: %d; buff strlen: %d; peek: 0x%02x",
-                debug_prefix, serial_count, strlen(serial_line_buffer), SERIAL_OBJ_IN.peek()
+                "%s: Serial available, partial_len: %d; peek: 0x%02x",
+                debug_prefix, serial_reader.partial_len(), SERIAL_OBJ_IN.peek()
             );
         }
     #endif
 
-    while ((queue_length() < MAX_QUEUE_LEN) && (SERIAL_OBJ_IN.available() > 0))
+    // Retained lines may have been waiting for room in the queue. They only need room for
+    // themselves, so they go before the reader reserves room for a line of any length
+    resend_release();
+
+    while (queue_accepting())
     {
-        // The character currently being read from serial
-        char serial_char = SERIAL_OBJ_IN.read();
-        if (IS_EOL(serial_char))
+        // Lines that arrive after a missing line may be retained or skipped, so their payloads are not streamed
+        serial_reader.hold_streaming = resend_active() || resend_rewinding();
+        const uint32_t ingest_started = latency_ticks();
+        const bool line_complete = serial_reader.next_line();
+        serial_ingest_ticks += latency_ticks() - ingest_started;
+        if (!line_complete)
         {
-            #if DEBUG_SERIAL
-                SER_SNPRINTF_COMMENT_PSTR("%s: serial char is EOL", debug_prefix);
-                debug_queue(debug_prefix);
-            #endif
-            serial_comment_mode = false; // end of line == end of comment
+            // Only time spent on a line counts, not polling for the next one
+            if (!serial_reader.partial_len())
+                serial_ingest_ticks = 0;
+            break;
+        }
+        latency_record_ticks(LATENCY_INGEST, serial_ingest_ticks);
+        serial_ingest_ticks = 0;
 
-            if (!serial_count)
-                continue; // Skip empty lines
+        #if DEBUG_SERIAL
+            SER_SNPRINTF_COMMENT_PSTR("%s: serial line complete (%d)", debug_prefix, serial_reader.line_len);
+            debug_queue(debug_prefix);
+        #endif
 
-            serial_line_buffer[serial_count] = 0; // Terminate string
-            serial_count = 0;                     // Reset buffer
+        char *command = serial_reader.line;
+        trace_event(TRACE_RECEIVED, serial_reader.line_len, *command == FRAME_PREFIX);
 
-            char *command = serial_line_buffer;
+        this_linenum = -1;
+        if (*command == FRAME_PREFIX)
+        {
+            // Binary frames carry their own crc, validated when processed
+            serial_reader.commit();
+            trace_event(TRACE_ENQUEUED, 0xFFFF, queue_length());
+            continue;
+        }
 
-            while (IS_SPACE(*command))
-                command++; // Skip leading spaces
+        // A streamed payload has already been written to the panel, validate it with the rest of the line
+        const bool streamed = serial_reader.streamed;
+        int stream_error = 0;
+        if (streamed) {
+            stream_error = stream_M260X_end(serial_reader.stream_len, serial_reader.stream_bad_tail);
+            // Streamed commands are done once their payload is, they are never parsed from the queue
+            trace_event(TRACE_DONE, stream_M260X_codenum(), stream_error);
+        }
 
-            this_linenum = -1;
-            error_code = validate_serial_special_fields(command);
-            if(error_code)
-            {
-                if(this_linenum >= 0){
-                    print_line_error(this_linenum, error_code, msg_buffer);
-                } else {
-                    print_error(error_code, msg_buffer);
-                }
-                #if DEBUG_QUEUE
-                    SER_SNPRINTF_COMMENT_PSTR("%s: After Validate Special Fields error", debug_prefix);
-                    debug_queue(debug_prefix);
-                #endif
-                SER_SNPRINTF_COMMENT_PSTR(
-                    "%s: Previous command: %s",
-                    debug_prefix, serial_line_buffer
-                );
+        const uint32_t validate_started = latency_ticks();
+        error_code = validate_serial_special_fields(
+            command, serial_reader.checksum, serial_reader.checksum_expected
+        );
+        latency_record(LATENCY_VALIDATE, validate_started);
+        if(error_code)
+        {
+            if(this_linenum >= 0){
+                print_line_error(this_linenum, error_code, msg_buffer);
+            } else {
+                print_error(error_code, msg_buffer);
+            }
+            #if DEBUG_QUEUE
+                SER_SNPRINTF_COMMENT_PSTR("%s: After Validate Special Fields error", debug_prefix);
+                debug_queue(debug_prefix);
+            #endif
+            SER_SNPRINTF_COMMENT_PSTR(
+                "%s: Previous command: %s",
+                debug_prefix, serial_reader.line
+            );
+            serial_reader.discard();
+            error_code = 0;
+            if (!resend_window_size || resend_rewinding()) {
+                resend_rewind();
                 flush_serial_resend();
-                error_code = 0;
+                return;
+            }
+            resend_line_failed(this_linenum);
+            continue;
+        }
 
+        switch (resend_check_line(this_linenum))
+        {
+        case RESEND_ACCEPT:
+            break;
+        case RESEND_RETAIN:
+            // A payload that was streamed before lines went missing has already been written,
+            // it is written again in order when the line is resent
+            if (streamed) {
+                resend_nak(this_linenum);
+            } else if (resend_retain(this_linenum, command, serial_reader.line_len)) {
+                print_line_ok(this_linenum);
+            } else {
+                SNPRINTF_MSG_PSTR("Resend window full, line %ld dropped", this_linenum);
+                print_line_error(this_linenum, 10, msg_buffer);
+                serial_reader.discard();
+                resend_rewind();
+                flush_serial_resend();
                 return;
+            }
+            serial_reader.discard();
+            continue;
+        case RESEND_DROP:
+            // Resent after it was received, ack it again
+            print_line_ok(this_linenum);
+            serial_reader.discard();
+            continue;
+        case RESEND_FLUSH:
+            SNPRINTF_MSG_PSTR("Line numbers not sequential. Current: %ld, Previous: %ld", this_linenum, last_linenum);
+            print_line_error(this_linenum, 10, msg_buffer);
+            serial_reader.discard();
+            resend_rewind();
+            flush_serial_resend();
+            return;
+        case RESEND_SKIP:
+            serial_reader.discard();
+            continue;
+        }
+        if(this_linenum >= 0){
+            last_linenum = this_linenum;
+        }
+
+        if (streamed)
+        {
+            // Streamed commands are complete once received, they are not queued
+            if (stream_error) {
+                if(this_linenum >= 0){
+                    print_line_error(this_linenum, stream_error, msg_buffer);
+                } else {
+                    print_error(stream_error, msg_buffer);
+                }
             } else {
+                commands_processed++;
                 if(this_linenum >= 0){
                     print_line_ok(this_linenum);
+                    last_parsed_linenum = this_linenum;
                 }
             }
-            #if !DISABLE_QUEUE
-                enqueue_command(command);
-            #else
-                enqueue_command("");
-                delay(1);
-            #endif
-        }
-        else if (serial_count >= MAX_CMD_SIZE - 1)
-        {
-            // if (DEBUG_QUEUE) { SER_SNPRINTF_COMMENT_PSTR("GSC: serial count %d is larger than MAX_CMD_SIZE: %d, ignore", serial_count, MAX_CMD_SIZE); }
-            // Keep fetching, but ignore normal characters beyond the max length
-            // The command will be injected when EOL is reached
-        }
-        else if (serial_char == ESCAPE_PREFIX)
-        { // Handle escapes
-            // if (DEBUG_QUEUE) { SER_SNPRINT_COMMENT_PSTR("GSC: serial char is escape"); }
-            if (SERIAL_OBJ.available() > 0)
-            {
-                // if we have one more character, copy it over
-                serial_char = SERIAL_OBJ.read();
-                if (!serial_comment_mode)
-                    serial_line_buffer[serial_count++] = serial_char;
-            }
-            // otherwise do nothing
+            serial_reader.discard();
+            continue;
         }
-        else
-        {
-            // if (DEBUG_QUEUE) { SER_SNPRINT_COMMENT_PSTR("GSC: serial char is regular"); }
-            // it's not a newline, carriage return or escape char
-            if (serial_char == COMMENT_PREFIX)
-                serial_comment_mode = true;
-            // So we can write it to the serial_line_buffer
-            if (!serial_comment_mode)
-                serial_line_buffer[serial_count++] = serial_char;
+        #if !DISABLE_QUEUE
+            serial_reader.commit();
+            trace_event(TRACE_ENQUEUED, this_linenum, queue_length());
+        #else
+            serial_reader.discard();
+            delay(1);
+        #endif
+        // Ack once committed so the free capacity includes this line
+        if(this_linenum >= 0){
+            print_line_ok(this_linenum);
         }
+        // Lines that were waiting for this one can follow it
+        resend_release();
     }
 
     #if DEBUG_SERIAL
-        if(serial_count){
+        if(serial_reader.partial_len()){
             SER_SNPRINTF_COMMENT_PSTR(
                 "%s: Partial read serial (%d)",
-                debug_prefix, serial_count
+                debug_prefix, serial_reader.partial_len()
             );
             debug_queue(debug_prefix);
         }
@@ -369,12 +393,14 @@ int gcode_M110(){
         SER_SNPRINTF_COMMENT_PSTR("GCO: Calling M%d", parser.codenum);
     #endif
 
-    if (parser.seen('N')){
+    // Numbered lines apply the new line number as they are received, see validate_serial_special_fields()
+    if (parser.seen('N') && parser.linenum < 0){
         long new_linenum = parser.value_long();
         #if DEBUG_GCODE
-            SER_SNPRINTF_COMMENT_PSTR("%s: -> new_linenum: %d", debug_prefix, new_linenum);
+            SER_SNPRINTF_COMMENT_PSTR("%s: -> new_linenum: %ld", debug_prefix, new_linenum);
         #endif
         last_linenum = new_linenum;
+        resend_clear();
     }
 
     return 0;
@@ -507,8 +533,36 @@ int process_parsed_command() {
         case 2602:
         case 2603:
             return gcode_M260X();
+        case 2604:
+            return gcode_M2604();
+        case 2605:
+            return gcode_M2605();
+        case 2606:
+            return gcode_M2606();
+        case 2607:
+            return gcode_M2607();
         case 2610:
             return gcode_M2610();
+        case 2611:
+            return gcode_M2611();
+        case 2612:
+            return gcode_M2612();
+        case 2613:
+            return gcode_M2613();
+        case 2615:
+            return gcode_M2615();
+        case 2616:
+            return gcode_M2616();
+        case 2617:
+            return gcode_M2617();
+        case 2618:
+            return gcode_M2618();
+        case 2620:
+            return gcode_M2620();
+        case 2621:
+            return gcode_M2621();
+        case 2622:
+            return gcode_M2622();
         case 9999:
             return gcode_M9999();;
         default:
@@ -519,6 +573,22 @@ int process_parsed_command() {
         {
         case 2205:
             gcode_P2205(); return 0;
+        case 2607:
+            return gcode_P2607();
+        case 2610:
+            return gcode_P2610();
+        case 2615:
+            return gcode_P2615();
+        case 2616:
+            return gcode_P2616();
+        case 2617:
+            return gcode_P2617();
+        case 2619:
+            return gcode_P2619();
+        case 2622:
+            return gcode_P2622();
+        case 2623:
+            return gcode_P2623();
         default:
             return parser.unknown_command_error();
         }
@@ -536,17 +606,36 @@ int process_parsed_command() {
 void process_next_command()
 {
     const char * debug_prefix = "PNC";
-    char *const current_command = command_queue[cmd_queue_index_r];
+    char *const current_command = queue_peek();
 
     #if DEBUG
         SER_SNPRINTF_COMMENT_PSTR("%s: Start", debug_prefix);
         SERIAL_OBJ.flush();
     #endif
 
+    if (*current_command == FRAME_PREFIX) {
+        // Binary frames bypass the GCode parser
+        parser.reset();
+        const uint32_t frame_started = latency_ticks();
+        error_code = process_frame(current_command + 1);
+        latency_record(LATENCY_DISPATCH, frame_started);
+        trace_event(TRACE_DONE, 0, error_code);
+        if(error_code != 0){
+            print_error(error_code, msg_buffer);
+        } else {
+            commands_processed++;
+        }
+        error_code = 0;
+        return;
+    }
+
     #if DEBUG_TIMING
         stopwatch_start_2();
     #endif
+    uint32_t started = latency_ticks();
     parser.parse(current_command);
+    latency_record(LATENCY_PARSE, started);
+    trace_event(TRACE_PARSED, parser.codenum, parser.command_letter);
 
     #if DEBUG
         SER_SNPRINTF_COMMENT_PSTR("%s: Parse", debug_prefix);
@@ -563,7 +652,10 @@ void process_next_command()
     #if DEBUG_TIMING
         stopwatch_start_2();
     #endif
+    started = latency_ticks();
     error_code = process_parsed_command();
+    latency_record(LATENCY_DISPATCH, started);
+    trace_event(TRACE_DONE, parser.codenum, error_code);
     #if DEBUG_TIMING
         process_parsed_cmd_time = stopwatch_stop_2();
     #endif
@@ -615,7 +707,6 @@ void setup()
         SER_SNPRINTF_COMMENT_PSTR("%s: sram size: %d", debug_prefix, SRAM_SIZE);
         SER_SNPRINTF_COMMENT_PSTR("%s: Free SRAM %d", debug_prefix, getFreeSram());
         // TODO: convert these to settings
-        SER_SNPRINTF_COMMENT_PSTR("%s: MAX_QUEUE_LEN: %d", debug_prefix, MAX_QUEUE_LEN);
         SER_SNPRINTF_COMMENT_PSTR("%s: MAX_CMD_SIZE: %d", debug_prefix, MAX_CMD_SIZE);
     #endif
 
@@ -654,6 +745,31 @@ void setup()
         }
     #endif
 
+    error_code = set_output_backend(OUTPUT_BACKEND);
+    if (error_code)
+    {
+        print_error(error_code, msg_buffer);
+        stop();
+    }
+
+    // Allocated before the queue, which takes most of the SRAM that is left
+    error_code = init_resend();
+    if (error_code)
+    {
+        print_error(error_code, msg_buffer);
+        stop();
+    }
+    #if DEBUG
+        SER_SNPRINTF_COMMENT_PSTR("%s: resend_window_size: %d", debug_prefix, resend_window_size);
+    #endif
+
+    error_code = init_jitter();
+    if (error_code)
+    {
+        print_error(error_code, msg_buffer);
+        stop();
+    }
+
     error_code = init_queue();
     if (error_code)
     {
@@ -665,6 +781,9 @@ void setup()
     else
     {
         SER_SNPRINT_COMMENT_PSTR("SET: Queue Setup: OK");
+        #if DEBUG
+            SER_SNPRINTF_COMMENT_PSTR("%s: queue_size: %d, queue_max_cmd_size: %d", debug_prefix, queue_size, queue_max_cmd_size);
+        #endif
     }
 
     error_code = init_clock();
@@ -676,6 +795,8 @@ void setup()
         SER_SNPRINT_COMMENT_PSTR("SET: Clock Setup: OK");
     }
 
+    init_latency();
+
 }
 
 void loop()
@@ -705,11 +826,15 @@ void loop()
                     panels[p][j].setHSV(hue, 255, 255);
                     pixels_set ++;
                 }
+                mark_panel_dirty(p, 0, panel_info[p]);
             }
-            FastLED.show();
+            show_panels();
         }
     }
 
+    // Keeps local_micros() from missing a wrap of micros() while no clock commands arrive
+    local_micros();
+
     time_t t_now = millis();
 
     #if DEBUG_LOOP
@@ -728,8 +853,13 @@ void loop()
                 command_rate = int(1000.0 * commands_processed / delta_started());
             }
             SER_SNPRINTF_COMMENT_PSTR(
-                "%s: FPS: %3d, CMD_RATE: %5d cps, PIX_RATE: %7d pps, QUEUE: %2d / %2d",
-                debug_prefix, fps, command_rate, pixel_set_rate, queue_length(), MAX_QUEUE_LEN
+                "%s: FPS: %3d, CMD_RATE: %5d cps, PIX_RATE: %7d pps, QUEUE: %2d, %5d / %5d bytes, DELTA_SAVED: %ld bytes",
+                debug_prefix, fps, command_rate, pixel_set_rate, queue_length(), queue_used_bytes(), queue_size,
+                delta_bytes_saved
+            );
+            SER_SNPRINTF_COMMENT_PSTR(
+                "%s: LATE: %ld, EARLY: %ld, SHOW_OVERLAP: %3d%%",
+                debug_prefix, frames_late, frames_early, take_output_overlap()
             );
             SERIAL_OBJ.flush();
             last_loop_debug = t_now;
@@ -738,7 +868,12 @@ void loop()
     #endif
 
 
-    if (queue_length() < MAX_QUEUE_LEN) {
+    // Show timed frames as close to their time as the loop allows
+    jitter_service();
+    output_service();
+
+    if (queue_accepting()) {
+        queue_was_full = false;
         #if DEBUG_TIMING
             last_queue_len = queue_length();
             stopwatch_start_1();
@@ -751,6 +886,9 @@ void loop()
                 debug_prefix, get_cmd_time, (queue_length() - last_queue_len)
             );
         #endif
+    } else if (!queue_was_full) {
+        trace_event(TRACE_QUEUE_FULL, queue_free_bytes());
+        queue_was_full = true;
     }
 
     // #if DEBUG_LOOP
@@ -762,7 +900,7 @@ void loop()
         #if DEBUG_TIMING
             SER_SNPRINTF_COMMENT_PSTR(
                 "%s: Next command (%d): '%s'",
-                debug_prefix, last_linenum, command_queue[cmd_queue_index_r]
+                debug_prefix, last_linenum, queue_peek()
             );
             last_pixels_set = pixels_set;
             last_cmd_rx = millis();
@@ -795,7 +933,12 @@ void loop()
             (t_now - last_loop_idle > LOOP_IDLE_PERIOD)
             && (t_now - last_loop_debug > LOOP_IDLE_PERIOD / 2 )
         ){
-            SER_SNPRINT_PSTR("IDLE");
+            trace_event(TRACE_IDLE, queue_free_bytes());
+            if (flow_control_enabled) {
+                SER_SNPRINTF_MSG_PSTR("IDLE C%d B%d", queue_free_slots(), queue_free_bytes());
+            } else {
+                SER_SNPRINT_PSTR("IDLE");
+            }
             last_loop_idle = t_now;
             idle_linenum = this_linenum;
         }
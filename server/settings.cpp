@@ -21,6 +21,7 @@
 #include "utility.h"
 #include "serial.h"
 #include "debug.h"
+#include "correction.h"
 
 TeleCortexSettings settings;
 
@@ -41,7 +42,7 @@ const char version[4] = EEPROM_VERSION;
 void TeleCortexSettings::write_data(int &pos, const uint8_t *value, uint16_t size, uint16_t *crc) {
     if (eeprom_error) return;
     while (size--) {
-        uint8_t * const p = (uint8_t * const)pos;
+        uint8_t * const p = (uint8_t * const)(uintptr_t)pos;
         uint8_t v = *value;
         // EEPROM has only ~100,000 write cycles,
         // so only write bytes that have changed!
@@ -64,7 +65,7 @@ void TeleCortexSettings::write_data(int &pos, const uint8_t *value, uint16_t siz
 void TeleCortexSettings::read_data(int &pos, uint8_t* value, uint16_t size, uint16_t *crc) {
     if (eeprom_error) return;
     do {
-        uint8_t c = eeprom_read_byte((unsigned char*)pos);
+        uint8_t c = eeprom_read_byte((unsigned char*)(uintptr_t)pos);
         *value = c;
         crc16(crc, &c, 1);
         pos++;
@@ -93,6 +94,13 @@ bool TeleCortexSettings::save() {
     // TODO: complete this
     EEPROM_WRITE(controller_id);
 
+    EEPROM_WRITE(global_correction);
+    for (int panel = 0; panel < MAX_PANELS; panel++) {
+        uint8_t own_correction = has_own_correction(panel);
+        EEPROM_WRITE(own_correction);
+        EEPROM_WRITE(panel_corrections[panel]);
+    }
+
     if (!eeprom_error) {
         const int eeprom_size = eeprom_index;
 
@@ -154,12 +162,26 @@ bool TeleCortexSettings::load() {
         );
         print_error(03, msg_buffer);
         // TODO: break here?
+        reset();
         return false;
         #endif
         reset();
     } else {
         EEPROM_READ(controller_id);
 
+        CorrectionSettings stored_global_correction = global_correction;
+        EEPROM_READ(stored_global_correction);
+        set_correction(GLOBAL_CORRECTION, &stored_global_correction);
+        for (int panel = 0; panel < MAX_PANELS; panel++) {
+            uint8_t own_correction = 0;
+            CorrectionSettings stored_correction = global_correction;
+            EEPROM_READ(own_correction);
+            EEPROM_READ(stored_correction);
+            if (own_correction) {
+                set_correction(panel, &stored_correction);
+            }
+        }
+
         // TODO: this
     }
 
@@ -175,6 +197,7 @@ bool TeleCortexSettings::load() {
 */
 void TeleCortexSettings::reset() {
     controller_id = DEFAULT_CONTROLLER_ID;
+    reset_corrections();
     //TODO: this
 
     postprocess();
@@ -187,6 +210,21 @@ void TeleCortexSettings::reset() {
 */
 void TeleCortexSettings::report(const bool forReplay) {
     SER_SNPRINTF_COMMENT_PSTR("SET: Controller ID: %d", controller_id);
+    SER_SNPRINTF_COMMENT_PSTR(
+        "SET: Colour correction: M2617 E%d S%d R%d G%d B%d",
+        global_correction.gamma, global_correction.brightness,
+        global_correction.white[0], global_correction.white[1], global_correction.white[2]
+    );
+    for (int panel = 0; panel < MAX_PANELS; panel++) {
+        if (has_own_correction(panel)) {
+            const CorrectionSettings *correction = &panel_corrections[panel];
+            SER_SNPRINTF_COMMENT_PSTR(
+                "SET: Colour correction: M2617 Q%d E%d S%d R%d G%d B%d",
+                panel, correction->gamma, correction->brightness,
+                correction->white[0], correction->white[1], correction->white[2]
+            );
+        }
+    }
 
     //TODO: this
 }
@@ -0,0 +1,37 @@
+#include "trace.h"
+
+#if TRACE_EVENTS
+    #if TRACE_EVENTS & (TRACE_EVENTS - 1)
+        #error "TRACE_EVENTS must be a power of 2"
+    #endif
+    TraceEvent trace_ring[TRACE_EVENTS];
+#endif
+
+unsigned long trace_recorded = 0;
+
+const TraceEvent *trace_get(int n) {
+    #if TRACE_EVENTS
+        const unsigned long kept = min(trace_recorded, (unsigned long)TRACE_EVENTS);
+        if (n < 0 || (unsigned long)n >= kept) {
+            return NULL;
+        }
+        return &trace_ring[(trace_recorded - kept + n) & (TRACE_EVENTS - 1)];
+    #else
+        return NULL;
+    #endif
+}
+
+void trace_pack(uint8_t *buf, const TraceEvent *event) {
+    buf[0] = event->time;
+    buf[1] = event->time >> 8;
+    buf[2] = event->time >> 16;
+    buf[3] = event->time >> 24;
+    buf[4] = event->arg;
+    buf[5] = event->arg >> 8;
+    buf[6] = event->type;
+    buf[7] = event->detail;
+}
+
+void trace_clear() {
+    trace_recorded = 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * Event Trace
+ * A ring of fixed size, timestamped events in SRAM, recording what the board
+ * was doing when frames stutter: lines arriving and being queued, commands
+ * running, shows, resend requests, the queue filling up and idling.
+ *
+ * Recording an event is a few stores, so it stays enabled at full frame
+ * rate. Once the ring is full the oldest events are overwritten.
+ * Times are latency_ticks(), see latency.h.
+ *
+ * Dumped with P2623, tools/trace.py converts the dump to Chrome trace JSON.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <Arduino.h>
+#include "config.h"
+#include "latency.h"
+
+// Event types, and what their arg and detail fields hold
+#define TRACE_RECEIVED 1        // A line or frame was read, arg: length, detail: 1 for a frame
+#define TRACE_ENQUEUED 2        // A line or frame was queued, arg: line number or 0xFFFF, detail: queue length
+#define TRACE_PARSED 3          // A queued line was parsed, arg: code number, detail: command letter
+#define TRACE_DONE 4            // A command, streamed command or frame finished, arg: code number or 0 for frames, detail: error code
+#define TRACE_SHOW_START 5      // Panels are being handed to the output backend, arg: panel mask
+#define TRACE_SHOW_END 6        // The output backend returned, arg: panel mask
+#define TRACE_RESEND 7          // A line was asked for again, arg: line number, detail: 'S' for RS, 'L' for RL
+#define TRACE_QUEUE_FULL 8      // The queue stopped accepting lines, arg: free bytes
+#define TRACE_IDLE 9            // Nothing was queued when IDLE was sent, arg: free bytes
+
+typedef struct {
+    uint32_t time;      // latency_ticks() when it happened
+    uint16_t arg;
+    uint8_t type;       // TRACE_*
+    uint8_t detail;
+} TraceEvent;
+
+// Bytes each event takes in a dump, little endian
+#define TRACE_EVENT_SIZE 8
+
+#if TRACE_EVENTS
+    extern TraceEvent trace_ring[TRACE_EVENTS];
+#endif
+
+// Events recorded since the ring was cleared, including those overwritten
+extern unsigned long trace_recorded;
+
+/**
+ * Record an event
+ */
+inline void trace_event(uint8_t type, uint16_t arg, uint8_t detail = 0) {
+    #if TRACE_EVENTS
+        TraceEvent *event = &trace_ring[trace_recorded++ & (TRACE_EVENTS - 1)];
+        event->time = latency_ticks();
+        event->arg = arg;
+        event->type = type;
+        event->detail = detail;
+    #endif
+}
+
+/**
+ * The nth oldest event still in the ring, NULL if there are not that many
+ */
+const TraceEvent *trace_get(int n);
+
+/**
+ * Write an event into buf as TRACE_EVENT_SIZE bytes, little endian
+ */
+void trace_pack(uint8_t *buf, const TraceEvent *event);
+
+/**
+ * Forget all events
+ */
+void trace_clear();
+
+#endif /* __TRACE_H__ */
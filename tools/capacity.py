@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Frame rate capacity planner.
+
+Estimates the frame rate of a board when every pixel of every panel is sent
+each frame, for each encoding and baud rate, and whether the serial link,
+decoding on the board, or clocking out the LEDs is the bottleneck. The model
+is the one in server/capacity.h: the link and the LEDs are worked out from
+the configuration, the decode time per pixel is given with --decode-ns.
+
+With --port, each estimate is also asked of the board with P2617, which
+measures its own decode time, and that is used for the model's estimate too.
+
+Example:
+
+    tools/capacity.py --panels 316,260,260,260 --chipset apa102 --baud 57600,115200,0
+"""
+
+import argparse
+import re
+import sys
+
+ENCODINGS = {'text': 0, 'binary': 1}
+
+# See server/capacity.h and server/frame.h
+TEXT_LINE_OVERHEAD = 26
+TEXT_SHOW_BYTES = 16
+BINARY_FRAME_OVERHEAD = 11
+FRAME_HEADER_LEN = 6
+FRAME_CRC_LEN = 2
+
+RE_ESTIMATE = re.compile(r'Y(\d+) L(\d+) D(\d+) C(\d+) T(\d+) F([\d.]+) X(\w+)')
+
+
+def clock_out_us(pixels, chipset, data_rate):
+    if chipset == 'apa102':
+        return (32 + 32 * pixels + pixels // 2) // data_rate
+    return 30 * pixels + 50
+
+
+def frame_bytes(panels, encoding, max_cmd_size):
+    total = 0
+    for pixels in panels:
+        if encoding == 'binary':
+            max_pixels = (max_cmd_size - 1 - BINARY_FRAME_OVERHEAD) // 3
+            for offset in range(0, pixels, max_pixels):
+                payload = 3 * min(max_pixels, pixels - offset)
+                total += BINARY_FRAME_OVERHEAD + payload + (FRAME_HEADER_LEN + payload + FRAME_CRC_LEN) // 254
+        else:
+            max_pixels = (max_cmd_size - 1 - TEXT_LINE_OVERHEAD) // 4
+            for offset in range(0, pixels, max_pixels):
+                total += TEXT_LINE_OVERHEAD + 4 * min(max_pixels, pixels - offset)
+    return total + (BINARY_FRAME_OVERHEAD if encoding == 'binary' else TEXT_SHOW_BYTES)
+
+
+def estimate(args, panels, encoding, baud, decode_ns):
+    size = frame_bytes(panels, encoding, args.max_cmd_size)
+    link = size * 10 * 1000000 // baud if baud else 0
+    decode = sum(panels) * decode_ns // 1000
+    leds = sum(clock_out_us(pixels, args.chipset, args.data_rate) for pixels in panels)
+    if args.no_pipeline:
+        frame = max(link, decode) + leds
+    else:
+        frame = max(link, decode + leds)
+    bottleneck = max((link, 'link'), (decode, 'decode'), (leds, 'leds'), key=lambda item: item[0])[1]
+    return size, link, decode, leds, frame, bottleneck
+
+
+def ask_board(link, encoding, baud):
+    link.reset_input_buffer()
+    link.write(b'P2617 E%d B%d\n' % (ENCODINGS[encoding], baud))
+    while True:
+        line = link.readline().decode('ascii', 'replace').strip()
+        if not line:
+            sys.exit('no response to P2617')
+        match = RE_ESTIMATE.search(line)
+        if match and not line.startswith(';'):
+            return match
+        if line.startswith('E'):
+            sys.exit(line)
+
+
+def row(source, encoding, baud, size, link, decode, leds, frame, bottleneck):
+    print('%-6s %-7s %8s %8d %9.1f %9.1f %9.1f %8.2f %-10s' % (
+        source, encoding, baud or 'usb', size, link / 1000.0, decode / 1000.0, leds / 1000.0,
+        1000000.0 / frame if frame else 0, bottleneck
+    ))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--panels', default='316,260,260,260', help='comma separated panel lengths')
+    parser.add_argument('--chipset', choices=('apa102', 'ws2812'), default='apa102')
+    parser.add_argument('--data-rate', type=int, default=10, help='APA102 data rate in MHz (APA_DATA_RATE)')
+    parser.add_argument('--baud', default='57600',
+                        help='comma separated baud rates to estimate for, 0 for native USB')
+    parser.add_argument('--encoding', choices=('text', 'binary', 'both'), default='both')
+    parser.add_argument('--decode-ns', type=int, default=0, help='time the board takes to decode a pixel')
+    parser.add_argument('--no-pipeline', action='store_true', help='the board is built without PIPELINED_SHOW')
+    parser.add_argument('--max-cmd-size', type=int, default=1500, help='MAX_CMD_SIZE')
+    parser.add_argument('--port', help='serial port of the board, to ask it for its own estimate')
+    parser.add_argument('--port-baud', type=int, default=57600, help='baud rate to talk to the board at')
+    args = parser.parse_args()
+
+    panels = [int(length) for length in args.panels.split(',')]
+    bauds = [int(baud) for baud in args.baud.split(',')]
+    encodings = ('text', 'binary') if args.encoding == 'both' else (args.encoding,)
+
+    link = None
+    if args.port:
+        import serial
+        link = serial.Serial(args.port, args.port_baud, timeout=5)
+    elif not args.decode_ns:
+        print('decode time not modelled, give --decode-ns or --port\n')
+
+    print('%-6s %-7s %8s %8s %9s %9s %9s %8s %-10s' % (
+        'source', 'encoding', 'baud', 'bytes', 'link ms', 'decode ms', 'leds ms', 'fps', 'bottleneck'
+    ))
+    for encoding in encodings:
+        for baud in bauds:
+            decode_ns = args.decode_ns
+            if link:
+                match = ask_board(link, encoding, baud)
+                size, link_us, decode, leds, frame = (int(match.group(n)) for n in range(1, 6))
+                row('board', encoding, baud, size, link_us, decode, leds, frame, match.group(7))
+                decode_ns = decode_ns or decode * 1000 // max(sum(panels), 1)
+            row('model', encoding, baud, *estimate(args, panels, encoding, baud, decode_ns))
+
+
+if __name__ == '__main__':
+    main()
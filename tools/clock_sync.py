@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""
+Clock sync for several controllers.
+
+Sets the synced clock of each board to this host's clock (ms since the Unix
+epoch, wrapping at 32 bits), so that frames timed with M2610 T / M2613 T are
+shown at the same moment on every board. Each round pings each board with
+P2615 a few times, takes the ping with the shortest round trip, and sets the
+clock with M2615. It reports the offset of the board's synced clock from the
+host clock before it was set, the round trip time, and the drift estimate.
+
+The board only estimates drift from syncs at least CLOCK_DRIFT_MIN_INTERVAL
+apart, so keep it running with --interval to correct for drift.
+
+Example:
+
+    tools/clock_sync.py /dev/ttyACM0 /dev/ttyACM1 --interval 30
+"""
+
+import argparse
+import re
+import sys
+import time
+
+RE_PING = re.compile(r'C(\d+) D(-?\d+) Y(\d) R(\d+) X(\d+)')
+RE_SYNC = re.compile(r'D(-?\d+)')
+PING = b'P2615\n'
+WRAP = 1 << 32
+
+
+def host_micros():
+    return time.time_ns() // 1000
+
+
+def signed(value):
+    """Interpret a difference of 32 bit timestamps as signed."""
+    value %= WRAP
+    return value - WRAP if value >= WRAP // 2 else value
+
+
+def read_response(link, pattern, command):
+    while True:
+        line = link.readline().decode('ascii', 'replace').strip()
+        if not line:
+            sys.exit('%s: no response to %s' % (link.port, command))
+        match = pattern.search(line)
+        if match and not line.startswith(';'):
+            return match
+        if line.startswith('E'):
+            sys.exit('%s: %s' % (link.port, line))
+
+
+class Board(object):
+    def __init__(self, port, baud, byte_us):
+        import serial
+        self.link = serial.Serial(port, baud, timeout=2)
+        self.port = port
+        self.byte_us = byte_us
+
+    def ping(self):
+        """
+        Returns (round trip us, host us at local X, synced clock offset us, drift ppb, synced, X).
+        Timestamps are moved to the last byte of the ping arriving and the first
+        byte of the response leaving, so that line lengths don't skew the offset.
+        """
+        self.link.reset_input_buffer()
+        sent = host_micros()
+        self.link.write(PING)
+        match = read_response(self.link, RE_PING, 'P2615')
+        returned = host_micros()
+        synced, drift, is_synced, received, transmitted = (int(group) for group in match.groups())
+        sent += len(PING) * self.byte_us
+        returned -= (len(match.group(0)) + 2) * self.byte_us
+        busy = signed(transmitted - received)
+        round_trip = (returned - sent) - busy
+        offset = signed(synced - (sent + round_trip // 2))
+        return round_trip, returned - round_trip // 2, offset, drift, bool(is_synced), transmitted
+
+    def sync(self, pings):
+        samples = [self.ping() for _ in range(pings)]
+        round_trip, host_us, offset, _, was_synced, transmitted = min(samples)
+        self.link.write(b'M2615 S%d T%d U%d\n' % (
+            transmitted, (host_us // 1000) % WRAP, host_us % 1000
+        ))
+        drift = int(read_response(self.link, RE_SYNC, 'M2615').group(1))
+        return round_trip, offset if was_synced else None, drift
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('ports', nargs='+', help='serial ports of the boards')
+    parser.add_argument('--baud', type=int, default=57600)
+    parser.add_argument('--usb', action='store_true',
+                        help='boards use native USB serial, so line lengths take no time')
+    parser.add_argument('--pings', type=int, default=8, help='pings per board per round')
+    parser.add_argument('--interval', type=float, default=0,
+                        help='seconds between rounds, 0 to sync once')
+    args = parser.parse_args()
+
+    byte_us = 0 if args.usb else 10 * 1000000 // args.baud
+    boards = [Board(port, args.baud, byte_us) for port in args.ports]
+
+    print('%-20s %10s %12s %12s' % ('port', 'rtt us', 'offset us', 'drift ppb'))
+    while True:
+        for board in boards:
+            round_trip, offset, drift = board.sync(args.pings)
+            print('%-20s %10d %12s %12d' % (
+                board.port, round_trip, 'unsynced' if offset is None else offset, drift
+            ))
+        if not args.interval:
+            break
+        time.sleep(args.interval)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+"""
+Lossy link simulator.
+
+Streams frames of pixel data to a TeleCortex server over a link that flips
+bits at a given bit error rate, and reports the effective frame rate.
+
+The server is either a board on a serial port (--port, needs pyserial), or a
+process that speaks the protocol on stdin / stdout (--command).
+
+Link time is worked out from the number of bits sent at --baud (8N1), so the
+result does not depend on how fast the server process runs. Errors are only
+injected from the host to the server, responses are assumed to be clean.
+
+The host side follows the server's resend protocol: lines are numbered and
+checksummed, acks are enabled with M2621, "RL <N>" resends line N only and
+"RS <N>" resends every line from N. Lines that are not acked within
+--timeout seconds are resent. With --go-back-n, "RL <N>" is answered like
+"RS <N>", to compare selective resend with resending everything after a
+missing line.
+
+Example:
+
+    tools/lossy_link.py --port /dev/ttyACM0 --ber 1e-5 --frames 200
+"""
+
+import argparse
+import base64
+import math
+import queue
+import random
+import re
+import subprocess
+import sys
+import threading
+import time
+
+RE_OK = re.compile(r'^N(\d+): OK')
+RE_RL = re.compile(r'^RL (\d+)')
+RE_RS = re.compile(r'^RS (\d+)')
+
+# Longest payload sent in a single M2600, in pixels
+PIXELS_PER_LINE = 100
+
+
+def checksum(line):
+    value = 0
+    for char in line:
+        value ^= ord(char)
+    return '%02X' % value
+
+
+def numbered(linenum, command):
+    line = 'N%d %s' % (linenum, command)
+    return '%s*%s\n' % (line, checksum(line))
+
+
+class BitErrorChannel(object):
+    """Flips bits at random with probability ber, skipping ahead geometrically."""
+
+    def __init__(self, ber, rng):
+        self.ber = ber
+        self.rng = rng
+        self.bits = 0
+        self.flips = 0
+        self.next_error = self._gap()   # Bits before the next error
+
+    def _gap(self):
+        if self.ber <= 0:
+            return float('inf')
+        return int(math.log(1.0 - self.rng.random()) / math.log(1.0 - self.ber))
+
+    def corrupt(self, data):
+        data = bytearray(data)
+        nbits = len(data) * 8
+        position = self.next_error
+        while position < nbits:
+            data[position // 8] ^= 1 << (position % 8)
+            self.flips += 1
+            position += 1 + self._gap()
+        self.next_error = position - nbits
+        self.bits += nbits
+        return bytes(data)
+
+
+class ProcessLink(object):
+    def __init__(self, command):
+        self.proc = subprocess.Popen(
+            command, shell=True, stdin=subprocess.PIPE, stdout=subprocess.PIPE
+        )
+        self.lines = queue.Queue()
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self):
+        for line in self.proc.stdout:
+            self.lines.put(line.decode('ascii', 'replace').strip())
+
+    def write(self, data):
+        self.proc.stdin.write(data)
+        self.proc.stdin.flush()
+
+    def close(self):
+        self.proc.stdin.close()
+        self.proc.wait()
+
+
+class SerialLink(object):
+    def __init__(self, port, baud):
+        import serial
+        self.serial = serial.Serial(port, baud, timeout=0.1)
+        self.lines = queue.Queue()
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self):
+        while True:
+            line = self.serial.readline()
+            if line:
+                self.lines.put(line.decode('ascii', 'replace').strip())
+
+    def write(self, data):
+        self.serial.write(data)
+
+    def close(self):
+        self.serial.close()
+
+
+def frame_commands(frame, panels, pixels, rng):
+    commands = []
+    for panel in range(panels):
+        for offset in range(0, pixels, PIXELS_PER_LINE):
+            count = min(PIXELS_PER_LINE, pixels - offset)
+            payload = bytes(rng.getrandbits(8) for _ in range(count * 3))
+            commands.append('M2600 Q%d S%d V%s' % (
+                panel, offset, base64.b64encode(payload).decode('ascii')
+            ))
+    commands.append('M2610')
+    return commands
+
+
+def run(args):
+    rng = random.Random(args.seed)
+    channel = BitErrorChannel(args.ber, rng)
+    if args.port:
+        link = SerialLink(args.port, args.baud)
+    else:
+        link = ProcessLink(args.command)
+
+    # Setup is sent clean, numbering restarts at 1 and every line is acked
+    link.write(numbered(0, 'M110 N0').encode('ascii'))
+    link.write(numbered(1, 'M2621 S1').encode('ascii'))
+    commands = []
+    for frame in range(args.frames):
+        commands.extend(frame_commands(frame, args.panels, args.pixels, rng))
+    lines = {}
+    for index, command in enumerate(commands):
+        lines[index + 2] = numbered(index + 2, command).encode('ascii')
+    first, last = 2, len(commands) + 1
+
+    acked = set([0, 1])
+    pending = []        # Line numbers to send again, in order
+    inflight = {}       # Time each line that has not been acked was sent
+    next_new = first
+    stats = {'lines': 0, 'resent': 0, 'RL': 0, 'RS': 0, 'timeouts': 0}
+    wall_start = time.time()
+
+    def send(linenum):
+        link.write(channel.corrupt(lines[linenum]))
+        inflight[linenum] = time.time()
+        stats['lines'] += 1
+
+    def go_back(linenum):
+        # Lines after N may have been acked and dropped, send them all again
+        linenum = max(linenum, first)
+        inflight.clear()
+        pending[:] = range(linenum, next_new)
+        acked.difference_update(pending)
+
+    while len(acked) < last + 1:
+        while pending and len(inflight) < args.window:
+            stats['resent'] += 1
+            send(pending.pop(0))
+        while next_new <= last and len(inflight) < args.window:
+            send(next_new)
+            next_new += 1
+        # Resend the oldest line that has not been acked in time
+        if inflight:
+            oldest = min(inflight)
+            if time.time() - inflight[oldest] > args.timeout:
+                stats['timeouts'] += 1
+                del inflight[oldest]
+                pending.insert(0, oldest)
+                continue
+        try:
+            response = link.lines.get(timeout=args.timeout)
+        except queue.Empty:
+            continue
+        if args.verbose:
+            print(response, file=sys.stderr)
+        match = RE_OK.match(response)
+        if match:
+            linenum = int(match.group(1))
+            acked.add(linenum)
+            inflight.pop(linenum, None)
+            continue
+        match = RE_RL.match(response)
+        if match:
+            stats['RL'] += 1
+            # Lines that have not been sent yet, or are already due to be sent again, are left alone
+            linenum = int(match.group(1))
+            if linenum in inflight:
+                if args.go_back_n:
+                    go_back(linenum)
+                else:
+                    del inflight[linenum]
+                    pending.append(linenum)
+            continue
+        match = RE_RS.match(response)
+        if match:
+            stats['RS'] += 1
+            go_back(int(match.group(1)))
+
+    wall_time = time.time() - wall_start
+    link.close()
+
+    link_time = channel.bits * 10.0 / 8 / args.baud
+    print('frames:        %d' % args.frames)
+    print('lines:         %d sent, %d resent, %d timeouts' % (
+        stats['lines'], stats['resent'], stats['timeouts']
+    ))
+    print('naks:          %d RL, %d RS' % (stats['RL'], stats['RS']))
+    print('bit errors:    %d in %d bits' % (channel.flips, channel.bits))
+    print('link time:     %.3f s at %d baud' % (link_time, args.baud))
+    print('effective fps: %.2f' % (args.frames / link_time))
+    if args.port:
+        print('wall fps:      %.2f' % (args.frames / wall_time))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    target = parser.add_mutually_exclusive_group(required=True)
+    target.add_argument('--port', help='serial port of the board')
+    target.add_argument('--command', help='server process that uses stdin / stdout')
+    parser.add_argument('--baud', type=int, default=57600)
+    parser.add_argument('--ber', type=float, default=1e-5, help='bit error rate')
+    parser.add_argument('--frames', type=int, default=100)
+    parser.add_argument('--panels', type=int, default=1)
+    parser.add_argument('--pixels', type=int, default=260, help='pixels per panel')
+    parser.add_argument('--window', type=int, default=8, help='lines in flight')
+    parser.add_argument('--timeout', type=float, default=0.5, help='seconds before resending')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--go-back-n', action='store_true', help='answer RL N by resending every line from N')
+    parser.add_argument('--verbose', action='store_true')
+    run(parser.parse_args())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""
+Compressed pixel payload codec.
+
+Encodes RGB pixels into the M2607 compressed payload format, and compares
+the payload size against M2600 for a few test patterns. The format is
+described in server/compress.h.
+
+With --port, each pattern is also sent to the board as a P2607 decoder
+benchmark, which reports the time the board takes to decode it, so the CPU
+cost can be weighed against the bytes saved.
+
+Example:
+
+    tools/pixel_codec.py --pixels 260 --port /dev/ttyACM0
+"""
+
+import argparse
+import base64
+import colorsys
+import random
+import re
+import sys
+
+RUN = 0x80
+REF = 0xC0
+MAX_LITERAL = 128
+MAX_RUN = 64
+MAX_REF = 65
+MAX_DISTANCE = 256
+
+RE_BENCH = re.compile(r'P(\d+) B(\d+) R(\d+) T(\d+)')
+
+
+def encode(pixels):
+    """Encode a list of (r, g, b) tuples, greedily taking the longest run or reference."""
+    out = bytearray()
+    literals = []
+
+    def flush():
+        while literals:
+            chunk = literals[:MAX_LITERAL]
+            del literals[:MAX_LITERAL]
+            out.append(len(chunk) - 1)
+            for pixel in chunk:
+                out.extend(pixel)
+
+    index = 0
+    while index < len(pixels):
+        run = 0
+        if index:
+            while (index + run < len(pixels) and run < MAX_RUN
+                   and pixels[index + run] == pixels[index - 1]):
+                run += 1
+        ref, ref_distance = 0, 0
+        for distance in range(2, min(index, MAX_DISTANCE) + 1):
+            length = 0
+            while (index + length < len(pixels) and length < MAX_REF
+                   and pixels[index + length] == pixels[index - distance + length]):
+                length += 1
+            if length > ref:
+                ref, ref_distance = length, distance
+        # A run costs 1 byte, a reference 2, a literal 3 per pixel
+        if run >= 1 and run >= ref:
+            flush()
+            out.append(RUN + run - 1)
+            index += run
+        elif ref >= 2:
+            flush()
+            out.append(REF + ref - 2)
+            out.append(ref_distance - 1)
+            index += ref
+        else:
+            literals.append(pixels[index])
+            index += 1
+    flush()
+    return bytes(out)
+
+
+def decode(data):
+    """Decode a payload back into a list of (r, g, b) tuples."""
+    pixels = []
+    index = 0
+    while index < len(data):
+        control = data[index]
+        index += 1
+        if control < RUN:
+            for _ in range(control + 1):
+                pixels.append(tuple(data[index:index + 3]))
+                index += 3
+        elif control < REF:
+            pixels.extend([pixels[-1]] * (control - RUN + 1))
+        else:
+            distance = data[index] + 1
+            index += 1
+            for _ in range(control - REF + 2):
+                pixels.append(pixels[-distance])
+    return pixels
+
+
+def patterns(count, rng):
+    def hsv(h, s, v):
+        return tuple(int(c * 255) for c in colorsys.hsv_to_rgb(h, s, v))
+    return [
+        ('solid', [(255, 0, 0)] * count),
+        ('blocks', [hsv((i // 20) / 13.0, 1, 1) for i in range(count)]),
+        ('stripes', [hsv((i % 8) / 8.0, 1, 1) for i in range(count)]),
+        ('gradient', [hsv(i / float(count), 1, 1) for i in range(count)]),
+        ('random', [tuple(rng.getrandbits(8) for _ in range(3)) for _ in range(count)]),
+    ]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--pixels', type=int, default=260, help='pixels per pattern')
+    parser.add_argument('--port', help='serial port of the board, to run the P2607 benchmark')
+    parser.add_argument('--baud', type=int, default=57600)
+    parser.add_argument('--iterations', type=int, default=100)
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+
+    link = None
+    if args.port:
+        import serial
+        link = serial.Serial(args.port, args.baud, timeout=5)
+
+    print('%-10s %8s %8s %7s %12s' % ('pattern', 'M2600', 'M2607', 'ratio', 'decode kpps'))
+    for name, pixels in patterns(args.pixels, random.Random(args.seed)):
+        payload = encode(pixels)
+        assert decode(payload) == pixels, name
+        raw = base64.b64encode(bytes(c for pixel in pixels for c in pixel))
+        compressed = base64.b64encode(payload).rstrip(b'=')
+        rate = ''
+        if link:
+            link.reset_input_buffer()
+            link.write(b'P2607 Q0 S0 I%d V%s\n' % (args.iterations, compressed))
+            while True:
+                line = link.readline().decode('ascii', 'replace').strip()
+                if not line:
+                    sys.exit('no response to P2607')
+                match = RE_BENCH.match(line)
+                if match:
+                    decoded, elapsed = int(match.group(1)), int(match.group(4))
+                    rate = '%.1f' % (decoded * 1000.0 / max(elapsed, 1))
+                    break
+                if line.startswith('E'):
+                    sys.exit(line)
+        print('%-10s %8d %8d %6.1fx %12s' % (
+            name, len(raw), len(compressed), len(raw) / float(len(compressed)), rate
+        ))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Event trace converter.
+
+Converts a dump of a board's trace ring (P2623, see server/trace.h) to Chrome
+trace JSON, which can be opened in chrome://tracing or https://ui.perfetto.dev
+to see what the board was doing when frames stuttered: commands running,
+shows, resend requests, the queue filling up, and lines arriving.
+
+The dump is read from a file of the board's output, e.g. from the host build's
+`replay --out`, from stdin with -, or straight from a board with --port.
+
+Example:
+
+    tools/trace.py --port /dev/ttyACM0 --clear -o trace.json
+"""
+
+import argparse
+import base64
+import json
+import re
+import struct
+import sys
+
+RE_SUMMARY = re.compile(r'D(\d+) R(\d+) U(\d+)')
+
+EVENT = struct.Struct('<IHBB')
+WRAP = 1 << 32
+
+# See server/trace.h
+TRACE_RECEIVED = 1
+TRACE_ENQUEUED = 2
+TRACE_PARSED = 3
+TRACE_DONE = 4
+TRACE_SHOW_START = 5
+TRACE_SHOW_END = 6
+TRACE_RESEND = 7
+TRACE_QUEUE_FULL = 8
+TRACE_IDLE = 9
+
+THREADS = {1: 'serial', 2: 'commands', 3: 'output'}
+
+
+def read_dump(lines):
+    """Returns (events as (time, arg, type, detail), events recorded, ticks per second)."""
+    data = b''
+    for line in lines:
+        line = line.strip()
+        if line.startswith('V'):
+            data += base64.b64decode(line[1:])
+            continue
+        match = RE_SUMMARY.search(line)
+        if match and not line.startswith(';'):
+            events = [EVENT.unpack_from(data, offset) for offset in range(0, len(data), EVENT.size)]
+            return events, int(match.group(2)), int(match.group(3))
+    sys.exit('no P2623 dump found')
+
+
+def ask_board(port, baud, clear):
+    import serial
+    link = serial.Serial(port, baud, timeout=5)
+    link.reset_input_buffer()
+    link.write(b'P2623 C1\n' if clear else b'P2623\n')
+
+    def lines():
+        while True:
+            line = link.readline().decode('ascii', 'replace')
+            if not line:
+                sys.exit('no response to P2623')
+            yield line
+    return read_dump(lines())
+
+
+def convert(events, ticks_per_second):
+    trace = [
+        {'ph': 'M', 'name': 'thread_name', 'pid': 0, 'tid': tid, 'args': {'name': name}}
+        for tid, name in THREADS.items()
+    ]
+    open_spans = {tid: 0 for tid in THREADS}
+    ticks = 0
+    last = None
+    for time, arg, kind, detail in events:
+        # Times wrap at 32 bits, events are close enough together to unwrap them in order
+        if last is not None:
+            ticks += (time - last) % WRAP
+        last = time
+        ts = ticks * 1000000.0 / ticks_per_second
+
+        def span(phase, tid, name=None, args=None):
+            if phase == 'E':
+                # The ring may have overwritten the start of a span
+                if not open_spans[tid]:
+                    return
+                open_spans[tid] -= 1
+            else:
+                open_spans[tid] += 1
+            event = {'ph': phase, 'pid': 0, 'tid': tid, 'ts': ts}
+            if name:
+                event['name'] = name
+            if args:
+                event['args'] = args
+            trace.append(event)
+
+        def instant(tid, name, args):
+            trace.append({'ph': 'i', 's': 't', 'pid': 0, 'tid': tid, 'ts': ts, 'name': name, 'args': args})
+
+        if kind == TRACE_PARSED:
+            span('B', 2, '%s%d' % (chr(detail), arg))
+        elif kind == TRACE_DONE:
+            if open_spans[2]:
+                span('E', 2, args={'error': detail} if detail else None)
+            else:
+                # Frames and streamed commands are not parsed from the queue, so have no start
+                instant(2, 'M%d streamed' % arg if arg else 'frame', {'error': detail})
+        elif kind == TRACE_SHOW_START:
+            span('B', 3, 'show', {'mask': '0x%x' % arg})
+        elif kind == TRACE_SHOW_END:
+            span('E', 3)
+        elif kind == TRACE_RECEIVED:
+            instant(1, 'frame received' if detail else 'line received', {'length': arg})
+        elif kind == TRACE_ENQUEUED:
+            instant(1, 'enqueued', {'line': -1 if arg == 0xFFFF else arg, 'queue': detail})
+        elif kind == TRACE_RESEND:
+            instant(1, 'R%s %d' % (chr(detail), arg), {'line': arg})
+        elif kind == TRACE_QUEUE_FULL:
+            instant(1, 'queue full', {'free bytes': arg})
+        elif kind == TRACE_IDLE:
+            instant(1, 'idle', {'free bytes': arg})
+        else:
+            instant(1, 'unknown %d' % kind, {'arg': arg, 'detail': detail})
+    return {'traceEvents': trace, 'displayTimeUnit': 'ms'}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('dump', nargs='?', help='file holding the board output with a P2623 dump, - for stdin')
+    parser.add_argument('--port', help='serial port of a board to dump')
+    parser.add_argument('--baud', type=int, default=57600, help='baud rate to talk to the board at')
+    parser.add_argument('--clear', action='store_true', help='clear the ring after dumping it (P2623 C1)')
+    parser.add_argument('-o', '--output', help='file to write the JSON to, default stdout')
+    args = parser.parse_args()
+
+    if args.port:
+        events, recorded, ticks_per_second = ask_board(args.port, args.baud, args.clear)
+    elif args.dump:
+        with (sys.stdin if args.dump == '-' else open(args.dump, encoding='ascii', errors='replace')) as dump:
+            events, recorded, ticks_per_second = read_dump(dump)
+    else:
+        parser.error('give a dump file or --port')
+
+    if recorded > len(events):
+        sys.stderr.write('%d older events were overwritten\n' % (recorded - len(events)))
+    output = open(args.output, 'w') if args.output else sys.stdout
+    json.dump(convert(events, ticks_per_second), output)
+    output.write('\n')
+
+
+if __name__ == '__main__':
+    main()